@@ -0,0 +1,77 @@
+//
+// backend.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef backend_h
+#define backend_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "frame.h"
+
+#if defined(__linux__) && !defined(NO_PIGPIO)
+#define HAVE_PIGPIO 1
+#endif
+
+// output backend: how edges reach the LEDs
+struct Backend {
+    const char *name;
+
+    // claim pins, leaving data and clock low; return false if backend unavailable
+    bool (*init)(void);
+
+    // send clock pulses, changing data pin first where an edge says so
+    void (*write_edges)(const Edge *edges, int count);
+
+    // optional: send whole frame some faster way; return false to have it sent as edges
+    bool (*write_frame)(const uint8_t *frame, int length);
+
+    // called after each complete frame
+    void (*flush)(void);
+
+    void (*close)(void);
+
+    // optional: print what the most recent frame cost
+    void (*report)(FILE *out);
+};
+typedef struct Backend Backend;
+
+#ifdef HAVE_PIGPIO
+extern const Backend pigpiod_backend;
+extern const Backend pigpio_backend;
+#endif
+
+#ifdef __linux__
+extern const Backend gpiod_backend;
+extern const Backend gpiomem_backend;
+#endif
+
+extern const Backend sim_backend;
+
+// backend in use; NULL until init_gpio() or first frame
+extern const Backend *backend;
+
+#endif /* backend_h */
@@ -0,0 +1,392 @@
+//
+// bench.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// benchmarks for frame encoding and output, state file I/O and command handling. Chain length
+// scaling runs against simulated LEDs; the rest run against a backend that only counts, so they
+// measure blinkt's own cost. Results print as a table, or as JSON with --json for comparing runs.
+// First, frames are checked byte for byte against known good ones, so a fast but wrong encoder
+// fails the run.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "backend.h"
+#include "blinkt.h"
+#include "command.h"
+#include "frame.h"
+#include "timing.h"
+
+// enough repetitions of each measurement to take a few milliseconds
+#define WORK_PIXELS 2000000
+
+typedef struct {
+    const char *name;
+    void (*run)(int k);
+    int repeat;
+} Bench;
+
+static bool json = false;
+
+// counting backend; a batch is one write_edges call, however many pins it writes
+static unsigned long count_batches;
+static unsigned long count_pin_writes;
+
+// state for operations
+static Flags flags;
+static Pixel *pixels;
+static Pixel *previous_pixels;
+static char state_path[] = "/tmp/blinkt-bench-XXXXXX";
+static FILE *null_out;
+
+static bool count_init(void)
+{
+    return true;
+}
+
+static void count_write_edges(const Edge *edges, int count)
+{
+    int i;
+
+    count_batches++;
+    for (i = 0; i < count; i++) count_pin_writes += edges[i] != EDGE_CLK ? 3 : 2;
+}
+
+static void count_flush(void)
+{
+}
+
+static void count_close(void)
+{
+}
+
+static const Backend count_backend = {
+    "count", count_init, count_write_edges, NULL, count_flush, count_close, NULL
+};
+
+// 3 pixels, so end frame is 32 + 2 bits, rounded up to 5 bytes
+#define CHECK_PIXELS 3
+#define CHECK_BYTES (START_FRAME_BYTES + PIXEL_BYTES * CHECK_PIXELS + 5)
+
+// default bgr order: start frame, then per pixel 0xE0 | brightness, blue, green, red
+static const uint8_t golden_frame[CHECK_BYTES] = {
+    0x00, 0x00, 0x00, 0x00,
+    0xFF, 0x33, 0x22, 0x11,
+    0xE1, 0x80, 0x00, 0xFF,
+    0xE0, 0x03, 0x02, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// rgb order; rgba brightness is alpha / 8
+static const uint8_t golden_raw_frame[CHECK_BYTES] = {
+    0x00, 0x00, 0x00, 0x00,
+    0xFF, 0x10, 0x20, 0x30,
+    0xE1, 0x40, 0x50, 0x60,
+    0xE0, 0x70, 0x80, 0x90,
+    0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static bool frame_matches(const char *name, const uint8_t *frame, const uint8_t *golden)
+{
+    int k;
+
+    for (k = 0; k < CHECK_BYTES; k++) {
+        if (frame[k] != golden[k]) {
+            fprintf(stderr, "%s: byte %d is %02X, should be %02X\n", name, k, frame[k], golden[k]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// compare build_frame and build_raw_frame output with known good frames; false if any differ
+static bool check_frames(void)
+{
+    static const Pixel check_pixels[CHECK_PIXELS] = {
+        { .brightness = 31, .red = 0x11, .green = 0x22, .blue = 0x33 },
+        { .brightness = 1, .red = 0xFF, .green = 0x00, .blue = 0x80 },
+        { .brightness = 0, .red = 0x01, .green = 0x02, .blue = 0x03 },
+    };
+    static const uint8_t raw[CHECK_PIXELS * 4] = {
+        0x10, 0x20, 0x30, 0xFF,
+        0x40, 0x50, 0x60, 0x08,
+        0x70, 0x80, 0x90, 0x07,
+    };
+    Profile saved = profile;
+    Flags check_flags;
+    uint8_t frame[CHECK_BYTES + 1];
+    bool ok = true;
+
+    profile.num_pixels = CHECK_PIXELS;
+    profile.gamma = false;
+    memset(&check_flags, 0, sizeof(check_flags));
+    check_flags.leds_on = true;
+
+    if (frame_bytes() != CHECK_BYTES) {
+        fprintf(stderr, "frame_bytes: %d, should be %d\n", frame_bytes(), CHECK_BYTES);
+        ok = false;
+    }
+
+    // byte past the end must be left alone
+    memset(frame, 0xAA, sizeof(frame));
+    build_frame(check_flags, check_pixels, frame);
+    ok = frame_matches("build_frame", frame, golden_frame) && frame[CHECK_BYTES] == 0xAA && ok;
+
+    profile.order[0] = 0;
+    profile.order[1] = 1;
+    profile.order[2] = 2;
+    memset(frame, 0xAA, sizeof(frame));
+    build_raw_frame(raw, 4, 0, frame);
+    ok = frame_matches("build_raw_frame", frame, golden_raw_frame) && frame[CHECK_BYTES] == 0xAA &&
+         ok;
+
+    profile = saved;
+    return ok;
+}
+
+// time encoding and transmitting one frame for chains from 8 to 4096 pixels
+static void bench_chain_length(void)
+{
+    int num_pixels;
+
+    if (json) {
+        printf("  \"chain_length\": [\n");
+
+    } else {
+        printf("# pixels  encode_ns  transmit_ns  encode_ns/pixel  transmit_ns/pixel\n");
+    }
+
+    for (num_pixels = 8; num_pixels <= 4096; num_pixels *= 2) {
+        Flags flags;
+        Pixel *pixels;
+        uint8_t *frame;
+        Edge *edges;
+        int repeat = WORK_PIXELS / num_pixels;
+        int64_t start;
+        double encode_ns, transmit_ns;
+        int k;
+
+        profile.num_pixels = num_pixels;
+        pixels = alloc_pixels();
+        frame = malloc(frame_bytes());
+        edges = malloc(frame_edges());
+        init_state(&flags, pixels);
+        for (k = 0; k < num_pixels; k++) pixels[k].red = k;
+
+        init_gpio();
+
+        start = now_ns();
+        for (k = 0; k < repeat; k++) {
+            build_frame(flags, pixels, frame);
+            encode_edges(frame, edges);
+        }
+        encode_ns = (double)(now_ns() - start) / repeat;
+
+        start = now_ns();
+        for (k = 0; k < repeat; k++) {
+            write_to_blinkt(flags, pixels);
+        }
+        transmit_ns = (double)(now_ns() - start) / repeat - encode_ns;
+
+        if (json) {
+            printf("    {\"pixels\": %d, \"encode_ns\": %.0f, \"transmit_ns\": %.0f}%s\n", num_pixels,
+                   encode_ns, transmit_ns, num_pixels < 4096 ? "," : "");
+
+        } else {
+            printf("%8d  %9.0f  %11.0f  %15.2f  %17.2f\n", num_pixels, encode_ns, transmit_ns,
+                   encode_ns / num_pixels, transmit_ns / num_pixels);
+        }
+
+        close_gpio();
+        free(edges);
+        free(frame);
+        free(pixels);
+    }
+
+    if (json) printf("  ],\n");
+}
+
+static void op_send_byte(int k)
+{
+    send_byte(k);
+}
+
+static void op_send_clocks(int k)
+{
+    send_clocks(32);
+}
+
+static void op_write_to_blinkt(int k)
+{
+    pixels[k & 7].red = k;
+    write_to_blinkt(flags, pixels);
+}
+
+static void op_parse_num(int k)
+{
+    static const char *numbers[] = { "255", "x1F", "b1010", "d12", "p3", "0", "x80", "200" };
+
+    pixels[0].red += parse_num(numbers[k & 7], 10);
+}
+
+static void op_read_state_file(int k)
+{
+    read_state_file(state_path, &flags, pixels);
+}
+
+static void op_write_state_file(int k)
+{
+    pixels[k & 7].blue = k;
+    write_state_file(state_path, flags, pixels);
+}
+
+static void op_command(int k)
+{
+    static const char *commands[][4] = {
+        { "blinkt", "p0", "red" },
+        { "blinkt", "rotate", "right" },
+        { "blinkt", "bright", "5" },
+        { "blinkt", "xF0", "blue" },
+    };
+
+    run_command(3, commands[k & 3], &flags, pixels, null_out, null_out);
+}
+
+// whole command the way main() runs it: load state, run command, save and send if changed
+static void op_invocation(int k)
+{
+    static const char *commands[][4] = {
+        { "blinkt", "p0", "red" },
+        { "blinkt", "p0", "blue" },
+    };
+    Flags previous_flags;
+
+    read_state_file(state_path, &flags, pixels);
+    copy_state(&flags, pixels, &previous_flags, previous_pixels);
+    run_command(3, commands[k & 1], &flags, pixels, null_out, null_out);
+
+    if (!states_are_same(&previous_flags, previous_pixels, &flags, pixels)) {
+        write_state_file(state_path, flags, pixels);
+        write_to_blinkt(flags, pixels);
+    }
+}
+
+static const Bench benches[] = {
+    { "send_byte", op_send_byte, 1000000 },
+    { "send_clocks_32", op_send_clocks, 1000000 },
+    { "write_to_blinkt", op_write_to_blinkt, 200000 },
+    { "parse_num", op_parse_num, 5000000 },
+    { "read_state_file", op_read_state_file, 200000 },
+    { "write_state_file", op_write_state_file, 100000 },
+    { "run_command", op_command, 1000000 },
+    { "invocation", op_invocation, 50000 },
+};
+
+// time operations on 8 pixels against counting backend
+static void bench_operations(void)
+{
+    int num_benches = sizeof(benches) / sizeof(benches[0]);
+    int fd = mkstemp(state_path);
+    int b;
+
+    if (fd < 0) {
+        perror(state_path);
+        exit(1);
+    }
+    close(fd);
+
+    null_out = fopen("/dev/null", "w");
+    profile.num_pixels = 8;
+    pixels = alloc_pixels();
+    previous_pixels = alloc_pixels();
+    init_state(&flags, pixels);
+    write_state_file(state_path, flags, pixels);
+
+    if (json) {
+        printf("  \"operations\": [\n");
+
+    } else {
+        printf("\n# operation          ns/op     batches/op  pin_writes/op       ops/s\n");
+    }
+
+    for (b = 0; b < num_benches; b++) {
+        const Bench *bench = &benches[b];
+        int64_t start;
+        double ns;
+        int k;
+
+        backend = &count_backend;
+        bench->run(0);      // warm up: allocate frame buffer, map state file
+
+        count_batches = 0;
+        count_pin_writes = 0;
+        start = now_ns();
+        for (k = 0; k < bench->repeat; k++) bench->run(k);
+        ns = (double)(now_ns() - start) / bench->repeat;
+
+        if (json) {
+            printf("    {\"name\": \"%s\", \"ns_per_op\": %.1f, \"batches_per_op\": %.2f, "
+                   "\"pin_writes_per_op\": %.1f, \"ops_per_sec\": %.0f}%s\n", bench->name, ns,
+                   (double)count_batches / bench->repeat, (double)count_pin_writes / bench->repeat,
+                   1e9 / ns, b < num_benches - 1 ? "," : "");
+
+        } else {
+            printf("%-18s %9.1f  %13.2f  %13.1f  %10.0f\n", bench->name, ns,
+                   (double)count_batches / bench->repeat, (double)count_pin_writes / bench->repeat,
+                   1e9 / ns);
+        }
+    }
+
+    if (json) printf("  ]\n");
+
+    close_gpio();
+    unlink(state_path);
+    fclose(null_out);
+    free(previous_pixels);
+    free(pixels);
+}
+
+int main(int argc, const char * argv[]) {
+    json = argc > 1 && strcmp(argv[1], "--json") == 0;
+
+    // measure encoding and decoding cost only, never real hardware
+    setenv("BLINKT_BACKEND", "sim", 1);
+
+    if (!check_frames()) {
+        fprintf(stderr, "Frame check failed\n");
+        return 1;
+    }
+
+    if (json) printf("{\n");
+    bench_chain_length();
+    bench_operations();
+    if (json) printf("}\n");
+
+    return 0;
+}
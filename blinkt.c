@@ -33,69 +33,215 @@
 #define __USE_POSIX199309 1
 #include <time.h>
 
-#include <sys/types.h>
-#include <sys/stat.h>
-
 #include "blinkt.h"
+#include "backend.h"
+#include "realtime.h"
+#include "stats.h"
+#include "timing.h"
 
 // buffer size for file I/O
 #define LINE_SIZE 256
 
-#ifdef __linux__
-// see http://abyz.me.uk/rpi/pigpio/
-#include <pigpiod_if2.h>
+// highest GPIO number on Raspberry Pi's BCM283x
+#define MAX_GPIO 53
 
-// GPIO pin assignments
-#define DAT 23
-#define CLK 24
+// clock pulses sent per call by send_clocks()
+#define CLOCK_CHUNK 64
 
-bool data_state;    // current state of data pin
+// backends to choose from with BLINKT_BACKEND
+const Backend *backends[] = {
+#ifdef HAVE_PIGPIO
+    &pigpiod_backend,
+    &pigpio_backend,
+#endif
+#ifdef __linux__
+    &gpiod_backend,
+    &gpiomem_backend,
 #endif
+    &sim_backend,
+};
 
-// intialize GPIO library and pins
-int pi = -1;
-bool daemon = false;
+const Backend *backend = NULL;
+bool data_state;    // current state of data pin
 
-void init_gpio(void)
+Profile profile = { BLINKT_PIXELS, BLINKT_DAT, BLINKT_CLK, { 2, 1, 0 }, false, true, 0, -1, false };
+
+// frame buffers, sized for profile on first use
+uint8_t *frame_buffer = NULL;
+Edge *edge_buffer = NULL;
+
+// number of GPIO calls or register writes made while sending most recent frame
+int frame_round_trips = 0;
+
+// read device profile, if it exists. Each line is a keyword and value:
+//   pixels 144
+//   dat 23
+//   clk 24
+//   order bgr
+//   realtime 50
+//   cpu 3
+//   stats on
+void read_profile(const char *path)
 {
-#ifdef __linux__
-    pi = pigpio_start(NULL, NULL);
-    if (pi >= 0) {
-        daemon = true;
+    FILE *file = fopen(path, "r");
+    char line[LINE_SIZE];
+    int line_number = 0;
+
+    if (file == NULL) return;
+
+    while (fgets(line, LINE_SIZE, file) != NULL) {
+        char key[LINE_SIZE];
+        char value[LINE_SIZE];
+        bool error = false;
+
+        line_number++;
+        if (sscanf(line, "%s %s", key, value) != 2 || key[0] == '#') continue;
+
+        if (strcmp(key, "pixels") == 0) {
+            int num_pixels = atoi(value);
+            error = num_pixels < 1 || num_pixels > MAX_PIXELS;
+            if (!error) profile.num_pixels = num_pixels;
+
+        } else if (strcmp(key, "dat") == 0 || strcmp(key, "clk") == 0) {
+            char *end;
+            long pin = strtol(value, &end, 10);
+
+            if (end == value || *end != '\0' || pin < 0 || pin > MAX_GPIO) {
+                fprintf(stderr, "%s line %d: %s must be a GPIO number from 0 to %d\n",
+                        path, line_number, key, MAX_GPIO);
+
+            } else if (key[0] == 'd') {
+                profile.dat = pin;
+
+            } else {
+                profile.clk = pin;
+            }
+
+        } else if (strcmp(key, "order") == 0) {
+            const char *names = "rgb";
+            uint8_t order[3];
+            int k;
+
+            error = strlen(value) != 3;
+            for (k = 0; k < 3 && !error; k++) {
+                const char *c = strchr(names, tolower(value[k]));
+                error = c == NULL || *c == '\0' || strchr(value + k + 1, value[k]) != NULL;
+                if (!error) order[k] = c - names;
+            }
+
+            if (!error) memcpy(profile.order, order, 3);
+
+        } else if (strcmp(key, "gamma") == 0 || strcmp(key, "dither") == 0 || strcmp(key, "stats") == 0) {
+            bool on = strcmp(value, "on") == 0;
+
+            error = !on && strcmp(value, "off") != 0;
+            if (!error && key[0] == 'g') profile.gamma = on;
+            if (!error && key[0] == 'd') profile.dither = on;
+            if (!error && key[0] == 's') profile.stats = on;
+
+        } else if (strcmp(key, "realtime") == 0) {
+            int priority = isdigit(value[0]) ? atoi(value) : 0;
+            error = (priority < 1 || priority > 99) && strcmp(value, "off") != 0;
+            if (!error) profile.realtime = priority;
+
+        } else if (strcmp(key, "cpu") == 0) {
+            int cpu = isdigit(value[0]) ? atoi(value) : -1;
+            error = cpu < 0 && strcmp(value, "any") != 0;
+            if (!error) profile.cpu = cpu;
+
+        } else {
+            error = true;
+        }
+
+        if (error) fprintf(stderr, "%s line %d not understood\n", path, line_number);
+    }
+
+    fclose(file);
 
-    } else if (gpioInitialise() < 0) {
-        fprintf(stderr, "start pigpiod or use sudo\n");
+    // one pin cannot carry both data and clock
+    if (profile.dat == profile.clk) {
+        fprintf(stderr, "%s: dat and clk are both GPIO %u; using %d and %d\n",
+                path, profile.dat, BLINKT_DAT, BLINKT_CLK);
+        profile.dat = BLINKT_DAT;
+        profile.clk = BLINKT_CLK;
+    }
+}
+
+// allocate pixel array for profile
+Pixel *alloc_pixels(void)
+{
+    Pixel *pixels = calloc(profile.num_pixels, sizeof(Pixel));
+
+    if (pixels == NULL) {
+        fprintf(stderr, "Out of memory\n");
         exit(1);
     }
 
-    if (daemon) {
-        set_mode(pi, DAT, PI_OUTPUT);
-        set_mode(pi, CLK, PI_OUTPUT);
-        gpio_write(pi, DAT, 0);
+    return pixels;
+}
 
-    } else {
-        gpioSetMode(DAT, PI_OUTPUT);
-        gpioSetMode(CLK, PI_OUTPUT);
+// intialize GPIO library and pins
+void init_gpio(void)
+{
+    const char *name = getenv("BLINKT_BACKEND");
+    int num_backends = sizeof(backends) / sizeof(backends[0]);
+    int k;
 
-        gpioWrite(DAT, 0);
+    if (name != NULL) {
+        for (k = 0; k < num_backends && backend == NULL; k++) {
+            if (strcmp(name, backends[k]->name) == 0) backend = backends[k];
+        }
+
+        if (backend == NULL) {
+            fprintf(stderr, "Unknown backend %s\n", name);
+            exit(1);
+        }
+
+        if (!backend->init()) {
+            fprintf(stderr, "Unable to start %s backend\n", name);
+            exit(1);
+        }
+
+    } else {
+#if defined(HAVE_PIGPIO)
+        // use pigpiod if running, otherwise pigpio library
+        backend = pigpiod_backend.init() ? &pigpiod_backend : &pigpio_backend;
+        if (backend == &pigpio_backend && !pigpio_backend.init()) {
+            fprintf(stderr, "start pigpiod or use sudo\n");
+            exit(1);
+        }
+#elif defined(__linux__)
+        backend = &gpiod_backend;
+        if (!backend->init()) exit(1);
+#else
+        backend = &sim_backend;
+        backend->init();
+#endif
     }
 
     data_state = false;
-#endif
 }
 
 void close_gpio(void)
 {
-    if (daemon) {
-        pigpio_stop(pi);
+    if (backend != NULL) backend->close();
+    backend = NULL;
+
+    free(frame_buffer);
+    free(edge_buffer);
+    frame_buffer = NULL;
+    edge_buffer = NULL;
+    reset_dither();
+}
 
-    } else {
-        gpioTerminate();
-    }
+// print what the most recent frame cost, if backend can tell
+void report_gpio(FILE *out)
+{
+    if (backend != NULL && backend->report != NULL) backend->report(out);
 }
 
 // initialize flags and pixels
-void init_state(Flags *flags, Pixel pixels[NUM_PIXELS])
+void init_state(Flags *flags, Pixel pixels[])
 {
     flags->left_to_right = true;
     flags->leds_on = true;
@@ -105,19 +251,19 @@ void init_state(Flags *flags, Pixel pixels[NUM_PIXELS])
     clear_pixels(pixels);
 }
 
-void copy_state(const Flags *from_flags, const Pixel from_pixels[NUM_PIXELS],
-                Flags *to_flags, Pixel to_pixels[NUM_PIXELS])
+void copy_state(const Flags *from_flags, const Pixel from_pixels[],
+                Flags *to_flags, Pixel to_pixels[])
 {
     int k;
 
     *to_flags = *from_flags;
-    for (k = 0; k < NUM_PIXELS; k++) {
+    for (k = 0; k < profile.num_pixels; k++) {
         to_pixels[k] = from_pixels[k];
     }
 }
 
-bool states_are_same(Flags *flags1, Pixel pixels1[NUM_PIXELS],
-                     Flags *flags2, Pixel pixels2[NUM_PIXELS])
+bool states_are_same(Flags *flags1, Pixel pixels1[],
+                     Flags *flags2, Pixel pixels2[])
 {
     int k;
     bool same =
@@ -127,7 +273,7 @@ bool states_are_same(Flags *flags1, Pixel pixels1[NUM_PIXELS],
         flags1->binary_on == flags2->binary_on &&
         flags1->binary_mask == flags2->binary_mask;
 
-    for (k = 0; k < NUM_PIXELS && same; k++) {
+    for (k = 0; k < profile.num_pixels && same; k++) {
         same =
             pixels1[k].red == pixels2[k].red &&
             pixels1[k].green == pixels2[k].green &&
@@ -138,116 +284,88 @@ bool states_are_same(Flags *flags1, Pixel pixels1[NUM_PIXELS],
     return same;
 }
 
-// read flags and pixels from state file, if it exists
-void read_state_file(const char *path, Flags *flags, Pixel pixels[NUM_PIXELS])
+// write pixel data to GPIO lines
+void write_to_blinkt(Flags flags, Pixel pixels[])
 {
-    bool error = false;
-    FILE *file = fopen(path, "r");
+    build_frame(flags, pixels, get_frame_buffer());
+    send_frame();
+}
 
-    if (file != NULL) {
-        struct stat statbuf;
-        error = stat(path, &statbuf) != 0;
+// frame buffer for current profile, allocated on first use; build a frame here for send_frame()
+uint8_t *get_frame_buffer(void)
+{
+    if (frame_buffer == NULL) {
+        frame_buffer = malloc(frame_bytes());
+        edge_buffer = malloc(frame_edges());
 
-        if (!error && statbuf.st_size == 0) {
-            init_state(flags, pixels);
-               fclose(file);
-            file = NULL;
+        if (frame_buffer == NULL || edge_buffer == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
         }
-    }
-
-    if (file != NULL) {
-        char line[LINE_SIZE];
-        int k;
-
-        error = fgets(line, LINE_SIZE, file) == NULL;
-        if (!error) flags->left_to_right = strcmp(line, "left\n") == 0;
 
-        if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
-        if (!error) flags->leds_on = strcmp(line, "on\n") == 0;
-
-        if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
-        if (!error) flags->holding = strcmp(line, "on\n") == 0;
+        lock_realtime_memory(frame_buffer, frame_bytes());
+        lock_realtime_memory(edge_buffer, frame_edges());
+    }
 
-        if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
-        if (!error) flags->binary_on = strcmp(line, "on\n") == 0;
+    return frame_buffer;
+}
 
-        if (!error) error = fscanf(file, "%hhd", &flags->binary_mask) != 1;
+// send edges a pixel at a time; return longest time any pixel took
+static int64_t write_timed_edges(int64_t start)
+{
+    int64_t gap = 0;
+    int edges = frame_edges();
+    int k;
 
-        for (k = 0; k < NUM_PIXELS && !error; k++) {
-            error = fscanf(file, "%hhd %hhd %hhd %hhd",
-                           &pixels[k].brightness,
-                           &pixels[k].blue,
-                           &pixels[k].green,
-                           &pixels[k].red ) != 4;
-        }
+    for (k = 0; k < edges; k += PIXEL_BYTES * 8) {
+        int64_t now;
 
-        fclose(file);
-        file = NULL;
+        backend->write_edges(edge_buffer + k, edges - k < PIXEL_BYTES * 8 ? edges - k : PIXEL_BYTES * 8);
+        now = now_ns();
+        if (now - start > gap) gap = now - start;
+        start = now;
     }
 
-    if (error) {
-        fprintf(stderr, "Error reading file %s\n", path);
-        // don't leave state half-read
-        init_state(flags, pixels);
-    }
+    return gap;
 }
 
-// write flags and pixels to state file
-void write_state_file(const char *path, Flags flags, Pixel pixels[NUM_PIXELS])
+// send frame built in frame buffer
+void send_frame(void)
 {
-    FILE *file = NULL;
+    bool realtime = profile.realtime > 0 || profile.cpu >= 0;
+    int64_t start = 0;
+    int64_t gap = 0;
+
+    // open GPIO on first frame, so commands that send nothing never pay for it
+    if (backend == NULL) {
+        mark_phase(PHASE_FRAME);
+        init_gpio();
+        mark_phase(PHASE_GPIO_INIT);
+    }
 
-    umask(0002);
-    file = fopen(path, "w");
+    // real-time priority only while frame goes out
+    if (realtime) enter_realtime();
 
-    if (file == NULL) {
-        fprintf(stderr, "Unable to open %s for writing\n", path);
+    frame_round_trips = 0;
+    if (profile.stats) start = now_ns();
 
-    } else {
-        bool error = false;
-        int k;
-
-        if (!error) error = fprintf(file, "%s\n", flags.left_to_right ? "left" : "right") < 0;
-        if (!error) error = fprintf(file, "%s\n", flags.leds_on ? "on" : "off") < 0;
-        if (!error) error = fprintf(file, "%s\n", flags.holding ? "on" : "off") < 0;
-        if (!error) error = fprintf(file, "%s\n", flags.binary_on ? "on" : "off") < 0;
-        if (!error) error = fprintf(file, "%d\n", flags.binary_mask) < 0;
-        for (k = 0; k < NUM_PIXELS && !error; k++) {
-            if (!error) error = fprintf(file, "%d %d %d %d\n",
-                    pixels[k].brightness,
-                    pixels[k].blue,
-                    pixels[k].green,
-                    pixels[k].red) < 0;
-        }
+    if (backend->write_frame == NULL || !backend->write_frame(frame_buffer, frame_bytes())) {
+        encode_edges(frame_buffer, edge_buffer);
 
-        fclose(file);
-        file = NULL;
+        if (profile.stats) {
+            gap = write_timed_edges(start);
 
-        if (error) {
-            fprintf(stderr, "Unable to write to %s\n", path);
+        } else {
+            backend->write_edges(edge_buffer, frame_edges());
         }
     }
-}
-
-// write pixel data to GPIO lines
-void write_to_blinkt(Flags flags, Pixel pixels[NUM_PIXELS])
-{
-    int k;
-
-    // start frame
-    send_clocks(32);
 
-    for (k = 0; k < NUM_PIXELS; k++) {
-        uint8_t brightness = (flags.leds_on ? pixels[k].brightness : 0) | 0b11100000;
-        if (flags.binary_on && ((flags.binary_mask & (1 << k)) == 0)) brightness = 0b11100000;
-        send_byte(brightness);
-        send_byte(pixels[k].blue);
-        send_byte(pixels[k].green);
-        send_byte(pixels[k].red);
-    }
+    // end frame leaves data pin low
+    data_state = false;
 
-    // end frame
-    send_clocks(36);
+    backend->flush();
+    if (profile.stats) record_frame(start, gap);
+    if (realtime) leave_realtime();
 }
 
 bool is_num_arg(const char *arg)
@@ -334,10 +452,10 @@ uint8_t swap_bits(uint8_t x)
 }
 
 // set all pixels to default values
-void clear_pixels(Pixel pixels[NUM_PIXELS])
+void clear_pixels(Pixel pixels[])
 {
     int k;
-    for (k = 0; k < NUM_PIXELS; k++) {
+    for (k = 0; k < profile.num_pixels; k++) {
         pixels[k].brightness = 7;
         pixels[k].blue = 0;
         pixels[k].green = 0;
@@ -345,6 +463,39 @@ void clear_pixels(Pixel pixels[NUM_PIXELS])
     }
 }
 
+// true if pixel k is selected by an 8-bit mask. Each bit covers one eighth of the chain, so on a
+// Blinkt! each bit is one pixel
+bool pixel_selected(uint8_t mask, int k)
+{
+    int bit = profile.num_pixels >= 8 ? k * 8 / profile.num_pixels : k;
+    return (mask & (1 << bit)) != 0;
+}
+
+// rotate count pixels starting at first; shift 1 moves each pixel to the next higher index,
+// shift -1 to the next lower index
+void rotate_pixels(Pixel pixels[], int first, int count, int shift)
+{
+    Pixel temp;
+    int k;
+
+    if (count < 2) return;
+
+    if (shift == -1) {
+        temp = pixels[first];
+        for (k = first; k < first + count - 1; k++) {
+            pixels[k] = pixels[k + 1];
+        }
+        pixels[first + count - 1] = temp;
+
+    } else if (shift == 1) {
+        temp = pixels[first + count - 1];
+        for (k = first + count - 2; k >= first; k--) {
+            pixels[k + 1] = pixels[k];
+        }
+        pixels[first] = temp;
+    }
+}
+
 // sleep for specified milliseconds
 void sleep_msec(int msec)
 {
@@ -358,62 +509,39 @@ void sleep_msec(int msec)
 #endif
 }
 
-// send one byte to GPIO pins
-void send_byte(uint8_t x)
+// send pre-rendered edges to GPIO pins
+void send_edges(const Edge *edges, int count)
 {
-#ifdef __linux__
     int i;
-    for (i = 0; i < 8; i++) {
-        bool new_state = (x & 0b10000000) != 0;
-        if (data_state != new_state) {
-            // only send to data pin if value has changed
-            if (daemon) {
-                gpio_write(pi, DAT, new_state);
 
-            } else {
-                gpioWrite(DAT, new_state);
-            }
-
-            data_state = new_state;
-        }
+    if (backend == NULL) return;
 
-        if (daemon) {
-            gpio_write(pi, CLK, 1);
-            gpio_write(pi, CLK, 0);
+    backend->write_edges(edges, count);
 
-        } else {
-            gpioWrite(CLK, 1);
-            gpioWrite(CLK, 0);
-        }
-
-        x = x << 1;
+    for (i = 0; i < count; i++) {
+        if (edges[i] != EDGE_CLK) data_state = edges[i] == EDGE_DAT1_CLK;
     }
-#endif
+}
+
+// send one byte to GPIO pins
+void send_byte(uint8_t x)
+{
+    send_edges(byte_edges[data_state][x], 8);
 }
 
 // send specified number of repeated transitions to clock pin
 void send_clocks(int count)
 {
-#ifdef __linux__
-    int i;
-    if (daemon) {
-        gpio_write(pi, DAT, 0);
+    Edge edges[CLOCK_CHUNK];
 
-    } else {
-        gpioWrite(DAT, 0);
-    }
-
-    data_state = 0;
-
-    for (i = 0; i < count; i++) {
-        if (daemon) {
-            gpio_write(pi, CLK, 1);
-            gpio_write(pi, CLK, 0);
+    // first clock always sets data low
+    memset(edges, EDGE_CLK, CLOCK_CHUNK);
+    edges[0] = EDGE_DAT0_CLK;
 
-        } else {
-            gpioWrite(CLK, 1);
-            gpioWrite(CLK, 0);
-        }
+    while (count > 0) {
+        int n = count < CLOCK_CHUNK ? count : CLOCK_CHUNK;
+        send_edges(edges, n);
+        edges[0] = EDGE_CLK;
+        count -= n;
     }
-#endif
 }
@@ -29,8 +29,17 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
-#define NUM_PIXELS 8
+#define FILE_PATH "/usr/local/share/blinkt"
+#define PROFILE_PATH "/usr/local/share/blinkt.conf"
+
+// defaults match the Pimoroni Blinkt!
+#define BLINKT_PIXELS 8
+#define BLINKT_DAT 23
+#define BLINKT_CLK 24
+
+#define MAX_PIXELS 65536
 
 struct Pixel {
     uint8_t brightness;
@@ -49,33 +58,73 @@ struct Flags {
 };
 typedef struct Flags Flags;
 
+// chain of LEDs attached to GPIO pins
+struct Profile {
+    int num_pixels;
+    unsigned dat;       // data GPIO
+    unsigned clk;       // clock GPIO
+    uint8_t order[3];   // color sent first, second, third after brightness: 0 red, 1 green, 2 blue
+    bool gamma;         // correct colors for eye's response
+    bool dither;        // with gamma, carry fraction of each level over to following frames
+    int realtime;       // SCHED_FIFO priority for frame output, or 0 for normal scheduling
+    int cpu;            // CPU to send frames from, or -1 for any
+    bool stats;         // record frame timing in stats file
+};
+typedef struct Profile Profile;
+
+extern Profile profile;
+
+// number of calls into GPIO daemon, library or driver, or register writes, made while sending
+// most recent frame; every backend counts them
+extern int frame_round_trips;
+
 // init functions
+void read_profile(const char *path);
+Pixel *alloc_pixels(void);
 void init_gpio(void);
-void init_state(Flags *flags, Pixel pixels[NUM_PIXELS]);
+void init_state(Flags *flags, Pixel pixels[]);
 
 void close_gpio(void);
+void report_gpio(FILE *out);
 
 // state functions
-void copy_state(const Flags *from_flags, const Pixel from_pixels[NUM_PIXELS],
-                Flags *to_flags, Pixel to_pixels[NUM_PIXELS]);
-bool states_are_same(Flags *flags1, Pixel pixels1[NUM_PIXELS],
-                     Flags *flags2, Pixel pixels2[NUM_PIXELS]);
+void copy_state(const Flags *from_flags, const Pixel from_pixels[],
+                Flags *to_flags, Pixel to_pixels[]);
+bool states_are_same(Flags *flags1, Pixel pixels1[],
+                     Flags *flags2, Pixel pixels2[]);
 
 // file functions
-void read_state_file(const char *path, Flags *flags, Pixel pixels[NUM_PIXELS]);
-void write_state_file(const char *path, Flags flags, Pixel pixels[NUM_PIXELS]);
+void read_state_file(const char *path, Flags *flags, Pixel pixels[]);
+void write_state_file(const char *path, Flags flags, Pixel pixels[]);
+
+// hold state lock across read, change and write; false if state file cannot be locked
+bool begin_state_update(const char *path);
+void end_state_update(void);
+
+// bus lock, so that one process at a time sends frames
+bool try_lock_bus(void);
+bool lock_bus(void);
+void unlock_bus(void);
+uint32_t state_generation(void);
 
 // high-level write pixels
-void write_to_blinkt(Flags flags, Pixel pixels[NUM_PIXELS]);
+void write_to_blinkt(Flags flags, Pixel pixels[]);
+
+// lower-level: build a frame in frame buffer (see frame.h), then send it
+uint8_t *get_frame_buffer(void);
+void send_frame(void);
 
 // utility functions
 bool is_num_arg(const char *arg);
 uint8_t parse_num(const char *arg, int default_base);
-void clear_pixels(Pixel pixels[NUM_PIXELS]);
+void clear_pixels(Pixel pixels[]);
+bool pixel_selected(uint8_t mask, int k);
+void rotate_pixels(Pixel pixels[], int first, int count, int shift);
 uint8_t swap_bits(uint8_t x);
 void sleep_msec(int msec);
 
 // low level GPIO functions
+void send_edges(const uint8_t *edges, int count);
 void send_byte(uint8_t x);
 void send_clocks(int count);
 
@@ -0,0 +1,312 @@
+//
+// blinktd.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// blinktd keeps GPIO open and LED state in memory, and runs blinkt commands sent over a Unix
+// socket. The state file is written at most once per SAVE_DELAY_MS, and on exit. No command may
+// block: clients wait out delays themselves, and fades are stepped from the poll loop, so every
+// client is answered at once. Frames are sent under the bus lock, and state written by another
+// process is picked up before the next command.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "blinkt.h"
+#include "blinktd.h"
+#include "command.h"
+#include "fade.h"
+#include "timing.h"
+
+// longest wait for a client to finish sending its request
+#define REQUEST_TIMEOUT_MS 1000
+
+// longest time state may go unsaved after a change
+#define SAVE_DELAY_MS 1000
+
+#define MAX_ARGS 64
+
+// create directory holding socket, writable only by this user; OK if it exists
+static void make_socket_directory(const char *path)
+{
+    char directory[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    char *slash;
+
+    strncpy(directory, path, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = 0;
+
+    slash = strrchr(directory, '/');
+    if (slash == NULL || slash == directory) return;
+
+    *slash = 0;
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) perror(directory);
+}
+
+// create listening socket; return -1 if another blinktd is already listening
+static int open_socket(const char *path)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "blinktd already running on %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    // remove socket left by a daemon that did not exit cleanly
+    make_socket_directory(path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        perror(path);
+        fprintf(stderr, "set BLINKT_SOCKET to a path in a directory blinktd may write\n");
+        close(fd);
+        return -1;
+    }
+
+    // any local user may send commands, as any user may run blinkt; only this user may remove
+    // or replace the socket, since only this user may write its directory
+    chmod(path, 0666);
+
+    return fd;
+}
+
+// read request into argument list; return argument count including program name
+static int read_request(int fd, char *request, const char *argv[])
+{
+    struct timeval timeout = { REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000 };
+    size_t length = 0;
+    int argc = 0;
+    size_t k;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    while (length < REQUEST_SIZE) {
+        ssize_t n = read(fd, request + length, REQUEST_SIZE - length);
+        if (n <= 0) break;
+        length += n;
+    }
+
+    argv[argc++] = "blinkt";
+    for (k = 0; k < length && argc < MAX_ARGS; k += strlen(request + k) + 1) {
+        // last argument may be missing its zero byte if request was cut short
+        if (memchr(request + k, 0, length - k) == NULL) break;
+        argv[argc++] = request + k;
+    }
+
+    return argc;
+}
+
+static bool write_all(int fd, const char *text, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(fd, text, length);
+        if (n <= 0) return false;
+
+        text += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+// if client has gone away, reply is dropped
+static void send_reply(int fd, const char *out, size_t out_length,
+                       const char *err, size_t err_length)
+{
+    char header[64];
+    int length = snprintf(header, sizeof(header), "%zu %zu\n", out_length, err_length);
+
+    if (write_all(fd, header, length) && write_all(fd, out, out_length)) {
+        write_all(fd, err, err_length);
+    }
+}
+
+// send frame under bus lock, unless hold is on
+static void show(Flags flags, Pixel pixels[])
+{
+    bool locked;
+
+    if (flags.holding) return;
+
+    locked = lock_bus();
+    write_to_blinkt(flags, pixels);
+    if (locked) unlock_bus();
+}
+
+// run one client's command; return true if state changed
+static bool handle_client(int fd, Flags *flags, Pixel pixels[],
+                          Flags *previous_flags, Pixel previous_pixels[])
+{
+    char request[REQUEST_SIZE];
+    const char *argv[MAX_ARGS];
+    int argc = read_request(fd, request, argv);
+    char *out_text = NULL;
+    char *err_text = NULL;
+    size_t out_length = 0;
+    size_t err_length = 0;
+    FILE *out = open_memstream(&out_text, &out_length);
+    FILE *err = open_memstream(&err_text, &err_length);
+    bool changed = false;
+
+    if (out != NULL && err != NULL) {
+        unsigned long fades = fades_started();
+
+        copy_state(flags, pixels, previous_flags, previous_pixels);
+        run_command(argc, argv, flags, pixels, out, err);
+
+        changed = !states_are_same(previous_flags, previous_pixels, flags, pixels);
+        if (changed) {
+            // newer state ends fade in progress, unless command started its own
+            if (fades_started() == fades) stop_fade();
+            if (!fade_running()) show(*flags, pixels);
+        }
+    }
+
+    if (out != NULL) fclose(out);
+    if (err != NULL) fclose(err);
+
+    send_reply(fd, out_text, out_length, err_text, err_length);
+
+    free(out_text);
+    free(err_text);
+
+    return changed;
+}
+
+int main(int argc, const char * argv[]) {
+    const char *profile_path = getenv("BLINKT_PROFILE");
+    const char *path = socket_path();
+    Pixel *previous_pixels;
+    Pixel *fade_pixels;
+    Pixel *pixels;
+    Flags previous_flags;
+    Flags flags;
+    int64_t save_time = 0;      // when state must be saved, or 0 if saved
+    uint32_t generation;        // state file generation last read or written
+    int listen_fd;
+
+    read_profile(profile_path != NULL ? profile_path : PROFILE_PATH);
+
+    previous_pixels = alloc_pixels();
+    fade_pixels = alloc_pixels();
+    pixels = alloc_pixels();
+
+    listen_fd = open_socket(path);
+    if (listen_fd < 0) return 1;
+
+    catch_stop();
+    signal(SIGPIPE, SIG_IGN);
+
+    defer_fades = true;
+    allow_delay = false;
+
+    init_gpio();
+    init_state(&flags, pixels);
+    read_state_file(FILE_PATH, &flags, pixels);
+    generation = state_generation();
+
+    while (!stop_requested) {
+        struct pollfd poll_fd = { listen_fd, POLLIN, 0 };
+        int timeout = -1;
+        int ready;
+        int client_fd;
+
+        if (save_time != 0) {
+            int64_t wait = save_time - now_ns();
+            timeout = wait > 0 ? (int)((wait + 999999) / 1000000) : 0;
+        }
+
+        // wake for next fade frame
+        if (fade_running() && (timeout < 0 || timeout > 1000 / FADE_MAX_FPS)) {
+            timeout = 1000 / FADE_MAX_FPS;
+        }
+
+        ready = poll(&poll_fd, 1, timeout);
+
+        // last fade frame shows state as it is now
+        if (fade_running()) show(flags, fade_frame(fade_pixels) ? fade_pixels : pixels);
+
+        if (save_time != 0 && now_ns() >= save_time) {
+            write_state_file(FILE_PATH, flags, pixels);
+            generation = state_generation();
+            save_time = 0;
+        }
+
+        // timed out, or interrupted by signal
+        if (ready <= 0) continue;
+
+        client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) continue;
+
+        // another process wrote state file since; its state is newer
+        if (state_generation() != generation) {
+            read_state_file(FILE_PATH, &flags, pixels);
+            generation = state_generation();
+            stop_fade();
+            save_time = 0;
+        }
+
+        if (handle_client(client_fd, &flags, pixels, &previous_flags, previous_pixels) &&
+            save_time == 0) {
+            // coalesce state file writes
+            save_time = now_ns() + SAVE_DELAY_MS * (int64_t)1000000;
+        }
+
+        close(client_fd);
+    }
+
+    if (save_time != 0) write_state_file(FILE_PATH, flags, pixels);
+
+    close_gpio();
+    close(listen_fd);
+    unlink(path);
+
+    free(pixels);
+    free(fade_pixels);
+    free(previous_pixels);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+//
+// blinktd.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef blinktd_h
+#define blinktd_h
+
+#include <stdbool.h>
+
+// socket where blinktd listens; BLINKT_SOCKET overrides. blinktd creates its directory, which
+// only blinktd's user may write, so no one else can remove or replace the socket.
+#define SOCKET_PATH "/run/blinkt/blinkt.sock"
+
+// longest request: all arguments, each followed by a zero byte
+#define REQUEST_SIZE 4096
+
+const char *socket_path(void);
+
+// have blinktd run command; return false if it is not running
+bool send_to_daemon(int argc, const char *argv[]);
+
+// true if blinktd is listening, in which case it owns GPIO
+bool daemon_running(void);
+
+#endif /* blinktd_h */
@@ -0,0 +1,152 @@
+//
+// client.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// client side of blinktd. Request is each argument followed by a zero byte. Reply is a line with
+// the lengths of standard output and standard error text, then the text itself.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "blinkt.h"
+#include "blinktd.h"
+#include "command.h"
+
+const char *socket_path(void)
+{
+    const char *path = getenv("BLINKT_SOCKET");
+    return path != NULL ? path : SOCKET_PATH;
+}
+
+// copy length bytes from socket to file
+static bool relay(FILE *from, FILE *to, size_t length)
+{
+    char buffer[REQUEST_SIZE];
+
+    while (length > 0) {
+        size_t n = fread(buffer, 1, length < REQUEST_SIZE ? length : REQUEST_SIZE, from);
+        if (n == 0) return false;
+
+        fwrite(buffer, 1, n, to);
+        length -= n;
+    }
+
+    return true;
+}
+
+// connect to blinktd; -1 if it is not running
+static int connect_daemon(void)
+{
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0) return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path(), sizeof(address.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool daemon_running(void)
+{
+    int fd = connect_daemon();
+
+    if (fd < 0) return false;
+
+    close(fd);
+    return true;
+}
+
+// send count arguments as one request, relay reply, and close connection
+static void send_request(int fd, int count, const char *args[])
+{
+    FILE *reply;
+    size_t out_length, err_length;
+    int k;
+
+    for (k = 0; k < count; k++) {
+        size_t length = strlen(args[k]) + 1;
+        if (write(fd, args[k], length) != (ssize_t)length) break;
+    }
+
+    shutdown(fd, SHUT_WR);
+
+    reply = fdopen(fd, "r");
+    if (reply == NULL) {
+        close(fd);
+        return;
+    }
+
+    if (fscanf(reply, "%zu %zu", &out_length, &err_length) != 2 || fgetc(reply) != '\n' ||
+        !relay(reply, stdout, out_length) || !relay(reply, stderr, err_length)) {
+        fprintf(stderr, "No reply from blinktd\n");
+    }
+
+    fclose(reply);
+}
+
+bool send_to_daemon(int argc, const char *argv[])
+{
+    int fd = connect_daemon();
+    int first, end;
+
+    if (fd < 0) return false;
+
+    // client waits out each delay itself, so that blinktd is never tied up; groups between
+    // delays go as separate requests
+    for (first = 1; first <= argc; first = end + 2) {
+        end = command_group_end(argc, argv, first);
+
+        if (end > first) {
+            if (fd < 0) fd = connect_daemon();
+            if (fd < 0) {
+                fprintf(stderr, "blinktd stopped\n");
+                return true;
+            }
+
+            send_request(fd, end - first, argv + first);
+            fd = -1;
+        }
+
+        if (end + 1 < argc) sleep_msec(atoi(argv[end + 1]));
+    }
+
+    if (fd >= 0) close(fd);
+
+    return true;
+}
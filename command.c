@@ -0,0 +1,548 @@
+//
+// command.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "command.h"
+#include "effects.h"
+#include "fade.h"
+#include "text.h"
+
+struct Color {
+    const char *name;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+typedef struct Color Color;
+
+static const Color colors[] = {
+    {"red",       255,      0,      0},
+    {"coral",     255,      8,      0},
+    {"orange",    255,     20,      0},
+    {"gold",      255,     60,      0},
+    {"yellow",    255,     88,      0},
+    {"lime",      160,    255,      0},
+    {"green",       0,    255,      0},
+    {"aqua",        0,     80,     24},
+    {"blue",        0,      0,    255},
+    {"purple",     72,      0,    120},
+    {"pink",      220,      0,     40},
+    {"white",     255,    255,    255},
+    {"black",       0,      0,      0},
+};
+
+// look up RGB for named color; false if no such color
+static bool find_color(const char *name, Pixel *color)
+{
+    int num_colors = sizeof(colors) / sizeof(Color);
+    int k;
+
+    for (k = 0; k < num_colors; k++) {
+        if (strcmp(name, colors[k].name) == 0) {
+            color->red = colors[k].red;
+            color->green = colors[k].green;
+            color->blue = colors[k].blue;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool allow_delay = true;
+
+// end of the group of arguments starting at first: index of next delay, or argc. Callers run each
+// group as a command of its own and wait out the delay between groups themselves, so that a delay
+// never runs with the state locked or blinktd busy.
+int command_group_end(int argc, const char *argv[], int first)
+{
+    while (first < argc && strcmp(argv[first], "delay") != 0) first++;
+
+    return first;
+}
+
+// milliseconds to wait if command is only a delay, otherwise -1. A client waits itself rather
+// than tie up the daemon.
+int command_delay(int argc, const char *argv[])
+{
+    int next_arg = 1;
+
+    if (next_arg < argc && is_num_arg(argv[next_arg])) next_arg++;
+
+    if (next_arg < argc && strcmp(argv[next_arg], "delay") == 0 && next_arg + 2 >= argc) {
+        return next_arg + 1 < argc ? atoi(argv[next_arg + 1]) : 0;
+    }
+
+    return -1;
+}
+
+// one group of arguments: optional select mask, keyword, then the keyword's own arguments
+struct Command {
+    int argc;
+    const char **argv;
+    int next_arg;               // first argument not used yet
+    const char *select_arg;     // select mask as given, or NULL if none
+    uint8_t select_mask;
+    Flags *flags;
+    Pixel *pixels;
+    FILE *out;
+    FILE *err;
+};
+typedef struct Command Command;
+
+struct Keyword {
+    const char *name;
+    void (*run)(Command *command);
+};
+typedef struct Keyword Keyword;
+
+// next argument, or NULL if none left
+static const char *next_word(Command *command)
+{
+    return command->next_arg < command->argc ? command->argv[command->next_arg++] : NULL;
+}
+
+// next argument without using it, or "" if none left
+static const char *peek_word(Command *command)
+{
+    return command->next_arg < command->argc ? command->argv[command->next_arg] : "";
+}
+
+// next argument as number, or 0 if none left
+static int next_num(Command *command, int default_base)
+{
+    const char *word = next_word(command);
+
+    return word != NULL ? parse_num(word, default_base) : 0;
+}
+
+static void set_color(Command *command, Pixel color)
+{
+    int k;
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        if (pixel_selected(command->select_mask, k)) {
+            command->pixels[k].red = color.red;
+            command->pixels[k].green = color.green;
+            command->pixels[k].blue = color.blue;
+        }
+    }
+}
+
+static void run_off(Command *command)
+{
+    command->flags->leds_on = false;
+}
+
+static void run_on(Command *command)
+{
+    command->flags->leds_on = true;
+    command->flags->holding = false;
+}
+
+static void run_left(Command *command)
+{
+    command->flags->left_to_right = true;
+}
+
+static void run_right(Command *command)
+{
+    command->flags->left_to_right = false;
+}
+
+static void run_hold(Command *command)
+{
+    command->flags->holding = true;
+}
+
+static void run_show(Command *command)
+{
+    command->flags->holding = false;
+}
+
+static void run_clear(Command *command)
+{
+    Flags *flags = command->flags;
+
+    // reset everything except left_to_right flag
+    flags->leds_on = true;
+    flags->holding = false;
+    flags->binary_on = false;
+    flags->binary_mask = 0xFF;
+    clear_pixels(command->pixels);
+}
+
+static void run_bright(Command *command)
+{
+    const char *word = next_word(command);
+    int k;
+
+    if (word != NULL) {
+        int brightness = parse_num(word, 10);
+
+        if (brightness < 0 || brightness > 31) {
+            fprintf(command->err, "Brightness must be 0 to 31\n");
+
+        } else {
+            for (k = 0; k < profile.num_pixels; k++) {
+                if (pixel_selected(command->select_mask, k)) command->pixels[k].brightness = brightness;
+            }
+        }
+    }
+}
+
+static void run_rgb(Command *command)
+{
+    Pixel color;
+    int red = next_num(command, 10);
+    int green = next_num(command, 10);
+    int blue = next_num(command, 10);
+
+    if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 || blue > 255) {
+        fprintf(command->err, "red green blue values must be 0 to 255\n");
+
+    } else {
+        color.red = red;
+        color.green = green;
+        color.blue = blue;
+        set_color(command, color);
+    }
+}
+
+static void run_binary(Command *command)
+{
+    Flags *flags = command->flags;
+    const char *word = next_word(command);
+
+    if (word == NULL) return;
+
+    if (strcmp(word, "off") == 0) {
+        flags->binary_on = false;
+
+    } else {
+        // up and down step from number shown, so animate can count
+        uint8_t shown = flags->left_to_right ? swap_bits(flags->binary_mask) : flags->binary_mask;
+
+        if (strcmp(word, "up") == 0) {
+            flags->binary_mask = flags->binary_on ? shown + 1 : 1;
+
+        } else if (strcmp(word, "down") == 0) {
+            flags->binary_mask = flags->binary_on ? shown - 1 : 255;
+
+        } else {
+            flags->binary_mask = parse_num(word, 10);
+        }
+
+        flags->binary_on = true;
+        if (flags->left_to_right) flags->binary_mask = swap_bits(flags->binary_mask);
+        flags->binary_mask |= ~command->select_mask;
+    }
+}
+
+static void run_delay(Command *command)
+{
+    const char *word = next_word(command);
+
+    if (!allow_delay) {
+        fprintf(command->err, "delay must be run by blinkt, not blinktd\n");
+        return;
+    }
+
+    if (word != NULL) sleep_msec(atoi(word));
+}
+
+static void run_rotate(Command *command)
+{
+    Flags *flags = command->flags;
+    Pixel *pixels = command->pixels;
+    const char *option = next_word(command);
+
+    if (option == NULL) return;
+
+    if (flags->binary_on) {
+        // if in binary mode, rotate binary mask instead of pixel settings
+        if (strcmp(option, "in") == 0) {
+            uint8_t left_mask = flags->binary_mask >> 4;
+            uint8_t right_mask = flags->binary_mask & 0xF;
+
+            left_mask = ((left_mask >> 1) | (left_mask << 3)) & 0xF;;
+            right_mask = ((right_mask << 1) | (right_mask >> 3)) & 0xF;
+
+            flags->binary_mask = (left_mask << 4) | right_mask;
+
+        } else if (strcmp(option, "out") == 0) {
+            uint8_t left_mask = flags->binary_mask >> 4;
+            uint8_t right_mask = flags->binary_mask & 0xF;
+
+            left_mask = ((left_mask << 1) | (left_mask >> 3)) & 0xF;
+            right_mask = ((right_mask >> 1) | (right_mask << 3)) & 0xF;;
+
+            flags->binary_mask = (left_mask << 4) | right_mask;
+
+        } else if (strcmp(option, "left") == 0) {
+            flags->binary_mask = (flags->binary_mask << 1) | (flags->binary_mask >> 7);
+
+        } else if (strcmp(option, "right") == 0) {
+            flags->binary_mask = (flags->binary_mask >> 1) | (flags->binary_mask << 7);
+        }
+
+    } else {
+        // rotate pixel settings
+        int half = profile.num_pixels / 2;
+        int shift = 0;
+        if (strcmp(option, "in") == 0) {
+            // from outside to center
+            rotate_pixels(pixels, 0, half, 1);
+            rotate_pixels(pixels, profile.num_pixels - half, half, -1);
+
+        } else if (strcmp(option, "out") == 0) {
+            // from center to outside
+            rotate_pixels(pixels, 0, half, -1);
+            rotate_pixels(pixels, profile.num_pixels - half, half, 1);
+
+        } else if (strcmp(option, "left") == 0) {
+            shift = 1;
+
+        } else if (strcmp(option, "right") == 0) {
+            shift = -1;
+        }
+
+        if (flags->left_to_right) shift *= -1;
+
+        rotate_pixels(pixels, 0, profile.num_pixels, shift);
+    }
+}
+
+static void run_refresh(Command *command)
+{
+    // resend current state to LEDs and report what it cost
+    write_to_blinkt(*command->flags, command->pixels);
+    report_gpio(command->out);
+}
+
+// fade [bright <n>] [<color> | rgb <r> <g> <b>] <msec> [linear | ease]
+static void run_fade(Command *command)
+{
+    Pixel *target = alloc_pixels();
+    Flags target_flags = *command->flags;
+    Curve curve = CURVE_LINEAR;
+    int msec = -1;
+    int k;
+
+    // build target by running color and bright commands on a copy
+    copy_state(command->flags, command->pixels, &target_flags, target);
+    while (command->next_arg < command->argc && msec < 0) {
+        const char *word = peek_word(command);
+        const char *part[6];
+        int num_parts = 0;
+        int length = strcmp(word, "rgb") == 0 ? 4 : strcmp(word, "bright") == 0 ? 2 : 1;
+
+        if (isdigit(word[0])) {
+            msec = atoi(next_word(command));
+
+        } else {
+            part[num_parts++] = command->argv[0];
+            if (command->select_arg != NULL) part[num_parts++] = command->select_arg;
+            for (k = 0; k < length && command->next_arg < command->argc; k++) {
+                part[num_parts++] = next_word(command);
+            }
+            run_command(num_parts, part, &target_flags, target, command->out, command->err);
+        }
+    }
+
+    if (strcmp(peek_word(command), "ease") == 0) {
+        curve = CURVE_EASE;
+        command->next_arg++;
+
+    } else if (strcmp(peek_word(command), "linear") == 0) {
+        command->next_arg++;
+    }
+
+    if (msec < 0) {
+        fprintf(command->err, "fade needs a time in milliseconds\n");
+
+    } else {
+        fade_pixels(*command->flags, command->pixels, target, msec, curve);
+    }
+
+    free(target);
+}
+
+// effect <name> [<color> | rgb <r> <g> <b>] [<period>]
+static void run_effect_command(Command *command)
+{
+    const char *name = next_word(command);
+    Pixel color = { 0, 255, 255, 255 };
+    int period = 0;
+
+    if (strcmp(peek_word(command), "rgb") == 0) {
+        command->next_arg++;
+        color.red = next_num(command, 10);
+        color.green = next_num(command, 10);
+        color.blue = next_num(command, 10);
+
+    } else if (find_color(peek_word(command), &color)) {
+        command->next_arg++;
+    }
+
+    if (isdigit(peek_word(command)[0])) period = atoi(next_word(command));
+
+    if (!run_effect(name != NULL ? name : "", *command->flags, command->select_mask, color, period,
+                    command->pixels)) {
+        fprintf(command->err, "Unknown effect\n");
+    }
+}
+
+static void run_state(Command *command)
+{
+    Flags *flags = command->flags;
+    FILE *out = command->out;
+    int k;
+
+    // print current state
+    fprintf(out, "Numbering: %s\n", flags->left_to_right ? "left to right" : "right to left");
+    fprintf(out, "LEDs: %s\n", flags->leds_on ? "on" : "off");
+    fprintf(out, "Holding: %s\n", flags->holding ? "on" : "off");
+    fprintf(out, "Binary: %s\n", flags->binary_on ? "on" : "off");
+    fprintf(out, "Binary mask: %d\n", flags->binary_mask);
+    fprintf(out, "\n");
+    fprintf(out, "# brightness red green blue\n");
+    for (k = 0; k < profile.num_pixels; k++) {
+        fprintf(out, "%d      %2d    %3d  %3d  %3d\n",
+               k,
+               command->pixels[k].brightness,
+               command->pixels[k].red,
+               command->pixels[k].green,
+               command->pixels[k].blue);
+    }
+}
+
+static void run_version(Command *command)
+{
+    version(command->out);
+}
+
+static void run_help(Command *command)
+{
+    usage(command->out);
+}
+
+static void run_man_page(Command *command)
+{
+    man_page_source(command->out);
+}
+
+static void run_license(Command *command)
+{
+    license(command->out);
+}
+
+// command keywords, sorted by name for bsearch
+static const Keyword keywords[] = {
+    { "binary", run_binary },
+    { "bright", run_bright },
+    { "clear", run_clear },
+    { "delay", run_delay },
+    { "effect", run_effect_command },
+    { "fade", run_fade },
+    { "help", run_help },
+    { "hold", run_hold },
+    { "left", run_left },
+    { "license", run_license },
+    { "man-page", run_man_page },
+    { "off", run_off },
+    { "on", run_on },
+    { "refresh", run_refresh },
+    { "rgb", run_rgb },
+    { "right", run_right },
+    { "rotate", run_rotate },
+    { "show", run_show },
+    { "state", run_state },
+    { "version", run_version },
+};
+
+static int compare_keyword(const void *name, const void *keyword)
+{
+    return strcmp(name, ((const Keyword *)keyword)->name);
+}
+
+// apply commands, each with optional select mask before it, to flags and pixels. Any number of
+// commands can follow one another; all change the same state.
+void run_command(int argc, const char *argv[], Flags *flags, Pixel pixels[], FILE *out, FILE *err)
+{
+    Command command;
+
+    command.argc = argc;
+    command.argv = argv;
+    command.next_arg = 1;
+    command.flags = flags;
+    command.pixels = pixels;
+    command.out = out;
+    command.err = err;
+
+    while (command.next_arg < argc) {
+        const Keyword *keyword;
+        const char *word;
+        Pixel color;
+
+        // read selection option, if present
+        command.select_arg = NULL;
+        command.select_mask = 0xFF;     // default is to change all pixels
+        if (is_num_arg(peek_word(&command))) {
+            command.select_arg = next_word(&command);
+            command.select_mask = parse_num(command.select_arg, 2);
+            if (flags->left_to_right) command.select_mask = swap_bits(command.select_mask);
+        }
+
+        word = next_word(&command);
+        if (word == NULL) {
+            // selection with nothing to apply it to
+            fprintf(err, "Missing command after %s\n", command.select_arg);
+            usage(out);
+            break;
+        }
+
+        keyword = bsearch(word, keywords, sizeof(keywords) / sizeof(keywords[0]), sizeof(Keyword),
+                          compare_keyword);
+
+        if (keyword != NULL) {
+            keyword->run(&command);
+
+        } else if (find_color(word, &color)) {
+            // set RGB by named color
+            set_color(&command, color);
+
+        } else {
+            // rest of line can't be split into commands reliably
+            fprintf(err, "Unknown option\n");
+            break;
+        }
+    }
+}
@@ -0,0 +1,346 @@
+//
+// dmx.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// DMX receiver for E1.31 (sACN) and Art-Net. Datagrams are read in batches with recvmmsg; packets
+// for our universe are checked against the last sequence number, and stale ones are dropped. The
+// newest packet in a batch is unpacked into the pixel array, three slots per pixel from the start
+// address, and sent as one frame. The kernel receive timestamp of that packet is compared with the
+// time the frame is on the wire to count receive-to-wire latency.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "dmx.h"
+#include "mode.h"
+#include "timing.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define DMX_SLOTS 512
+#define MAX_PACKET 638                  // largest E1.31 data packet
+#define BATCH 32
+
+// sequence numbers this far behind the last one are stale, per E1.31
+#define STALE_WINDOW 20
+
+#define E131_DMX_OFFSET 126             // slot 1, after start code
+#define ARTNET_DMX_OFFSET 18
+
+typedef enum { PROTOCOL_E131, PROTOCOL_ARTNET } Protocol;
+
+typedef struct {
+    uint8_t sequence;
+    bool have_sequence;
+    long packets;
+    long stale;
+    long frames;
+    int64_t latency_total;              // nanoseconds
+    int64_t latency_max;
+} Receiver;
+
+static const uint8_t e131_identifier[] = {
+    0x00, 0x10, 0x00, 0x00, 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0x00, 0x00, 0x00
+};
+
+static const uint8_t artnet_identifier[] = {
+    'A', 'r', 't', '-', 'N', 'e', 't', 0x00, 0x00, 0x50     // ID and OpDmx, little-endian
+};
+
+static int64_t realtime_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// find DMX data in packet for universe; return slot count, or -1 if not ours
+static int find_dmx(Protocol protocol, int universe, const uint8_t *packet, int length,
+                    const uint8_t **data, uint8_t *sequence)
+{
+    int slots;
+
+    if (protocol == PROTOCOL_E131) {
+        if (length < E131_DMX_OFFSET || memcmp(packet, e131_identifier, sizeof(e131_identifier)) != 0)
+            return -1;
+        if (packet[21] != 0x04 || packet[43] != 0x02 || packet[117] != 0x02) return -1;  // data vectors
+        if (((packet[113] << 8) | packet[114]) != universe) return -1;
+        if (packet[112] & 0x80) return -1;                      // preview data
+        if (packet[125] != 0) return -1;                        // start code other than dimmer data
+
+        slots = ((packet[123] << 8) | packet[124]) - 1;
+        *sequence = packet[111];
+        *data = packet + E131_DMX_OFFSET;
+        if (slots > length - E131_DMX_OFFSET) slots = length - E131_DMX_OFFSET;
+
+    } else {
+        if (length < ARTNET_DMX_OFFSET || memcmp(packet, artnet_identifier, sizeof(artnet_identifier)) != 0)
+            return -1;
+        if (((packet[15] << 8) | packet[14]) != universe) return -1;
+
+        slots = (packet[16] << 8) | packet[17];
+        *sequence = packet[12];
+        *data = packet + ARTNET_DMX_OFFSET;
+        if (slots > length - ARTNET_DMX_OFFSET) slots = length - ARTNET_DMX_OFFSET;
+    }
+
+    return slots > DMX_SLOTS ? DMX_SLOTS : slots;
+}
+
+// true if sequence is not behind the last one; Art-Net sequence 0 means not sequenced
+static bool in_sequence(Protocol protocol, Receiver *receiver, uint8_t sequence)
+{
+    int8_t delta = (int8_t)(sequence - receiver->sequence);
+
+    if (protocol == PROTOCOL_ARTNET && sequence == 0) return true;
+
+    if (receiver->have_sequence && delta <= 0 && delta > -STALE_WINDOW) return false;
+
+    receiver->sequence = sequence;
+    receiver->have_sequence = true;
+    return true;
+}
+
+// set pixels from slots starting at address (1-based), numbering from left end of board
+static void unpack_slots(Flags flags, const uint8_t *data, int slots, int address, Pixel pixels[])
+{
+    int p;
+
+    for (p = 0; p < profile.num_pixels && address - 1 + 3 * p + 2 < slots; p++) {
+        const uint8_t *rgb = data + address - 1 + 3 * p;
+        int k = flags.left_to_right ? p : profile.num_pixels - 1 - p;
+
+        pixels[k].red = rgb[0];
+        pixels[k].green = rgb[1];
+        pixels[k].blue = rgb[2];
+    }
+}
+
+static int open_receiver(Protocol protocol, int port, int universe)
+{
+    struct sockaddr_in address;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("dmx");
+        close(fd);
+        return -1;
+    }
+
+    // E1.31 senders usually multicast to 239.255.<universe>; without a multicast route, unicast still works
+    if (protocol == PROTOCOL_E131) {
+        struct ip_mreq group;
+
+        group.imr_multiaddr.s_addr = htonl(0xEFFF0000 | universe);
+        group.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group));
+    }
+
+    return fd;
+}
+
+// kernel receive time of message, or fallback if none was attached
+static int64_t receive_time(struct msghdr *header, int64_t fallback)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(header); cmsg != NULL; cmsg = CMSG_NXTHDR(header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec stamp;
+
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            return (int64_t)stamp.tv_sec * 1000000000 + stamp.tv_nsec;
+        }
+    }
+
+    return fallback;
+}
+
+int run_dmx_receiver(int argc, const char *argv[])
+{
+    static uint8_t packets[BATCH][MAX_PACKET];
+    static uint8_t controls[BATCH][CMSG_SPACE(sizeof(struct timespec))];
+    struct mmsghdr messages[BATCH];
+    struct iovec vectors[BATCH];
+    Receiver receiver;
+    Protocol protocol = PROTOCOL_E131;
+    int universe = 1;
+    int address = 1;
+    int port = 0;
+    int max_universe;
+    bool valid = argc > 2;
+    Pixel *pixels;
+    Flags flags;
+    int fd;
+    int k;
+
+    if (valid && strcmp(argv[2], "artnet") == 0) {
+        protocol = PROTOCOL_ARTNET;
+        universe = 0;
+
+    } else if (valid && strcmp(argv[2], "e131") != 0) {
+        valid = false;
+    }
+
+    for (k = 3; valid && k < argc; k++) {
+        if (strcmp(argv[k], "--universe") == 0 && k + 1 < argc) {
+            universe = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--address") == 0 && k + 1 < argc) {
+            address = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--port") == 0 && k + 1 < argc) {
+            port = atoi(argv[++k]);
+
+        } else {
+            valid = false;
+        }
+    }
+
+    if (port == 0) port = protocol == PROTOCOL_E131 ? E131_PORT : ARTNET_PORT;
+    max_universe = protocol == PROTOCOL_E131 ? 63999 : 32767;
+
+    if (!valid || universe < (protocol == PROTOCOL_E131 ? 1 : 0) || universe > max_universe ||
+        address < 1 || address > DMX_SLOTS - 2 || port < 1 || port > 65535) {
+        fprintf(stderr, "Usage: blinkt dmx (e131 | artnet) [--universe N] [--address 1-510] "
+                "[--port 1-65535]\n");
+        return 1;
+    }
+
+    pixels = begin_mode(&flags);
+
+    fd = open_receiver(protocol, port, universe);
+    if (fd < 0) {
+        free(pixels);
+        return 1;
+    }
+
+    for (k = 0; k < BATCH; k++) {
+        vectors[k].iov_base = packets[k];
+        vectors[k].iov_len = MAX_PACKET;
+    }
+
+    memset(&receiver, 0, sizeof(receiver));
+
+    fprintf(stderr, "Listening for %s on port %d, universe %d, address %d\n",
+            protocol == PROTOCOL_E131 ? "E1.31" : "Art-Net", port, universe, address);
+
+    while (!stop_requested) {
+        int64_t received_at = 0;
+        int count;
+
+        // headers are updated by each call, so reset them
+        memset(messages, 0, sizeof(messages));
+        for (k = 0; k < BATCH; k++) {
+            messages[k].msg_hdr.msg_iov = &vectors[k];
+            messages[k].msg_hdr.msg_iovlen = 1;
+            messages[k].msg_hdr.msg_control = controls[k];
+            messages[k].msg_hdr.msg_controllen = sizeof(controls[k]);
+        }
+
+        // block for first datagram, then take whatever else is queued
+        count = recvmmsg(fd, messages, BATCH, MSG_WAITFORONE, NULL);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("recvmmsg");
+            break;
+        }
+
+        for (k = 0; k < count; k++) {
+            const uint8_t *data;
+            uint8_t sequence;
+            int slots = find_dmx(protocol, universe, packets[k], messages[k].msg_len, &data, &sequence);
+
+            if (slots < 0) continue;
+
+            receiver.packets++;
+            if (!in_sequence(protocol, &receiver, sequence)) {
+                receiver.stale++;
+                continue;
+            }
+
+            // later packets in batch overwrite earlier ones
+            unpack_slots(flags, data, slots, address, pixels);
+            received_at = receive_time(&messages[k].msg_hdr, realtime_ns());
+        }
+
+        if (received_at != 0) {
+            int64_t latency;
+
+            show_frame(flags, pixels);
+            latency = realtime_ns() - received_at;
+
+            receiver.frames++;
+            receiver.latency_total += latency;
+            if (latency > receiver.latency_max) receiver.latency_max = latency;
+        }
+    }
+
+    close(fd);
+    end_mode(flags, pixels, true);
+
+    fprintf(stderr, "%ld packets, %ld stale, %ld frames, latency %.1f us mean, %.1f us max\n",
+            receiver.packets, receiver.stale, receiver.frames,
+            receiver.frames > 0 ? receiver.latency_total / 1e3 / receiver.frames : 0.0,
+            receiver.latency_max / 1e3);
+
+    return 0;
+}
+
+#else
+
+int run_dmx_receiver(int argc, const char *argv[])
+{
+    fprintf(stderr, "DMX receiver needs Linux\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,225 @@
+//
+// effects.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// effects compute each frame from the monotonic clock, so they keep time however often they are
+// drawn: run them with animate, e.g. blinkt animate effect rainbow --fps 60. Sparkle is the
+// exception; it fades what the previous frame left. All math is integer, with 8-bit sine and hue
+// tables, so an effect costs a few table lookups per pixel.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "effects.h"
+#include "timing.h"
+
+// default milliseconds per cycle
+#define RAINBOW_PERIOD 5000
+#define BREATHE_PERIOD 4000
+#define CHASE_PERIOD 1000
+#define LARSON_PERIOD 2000
+#define WIPE_PERIOD 2000
+
+// default chance in 256 that a pixel sparkles on a frame
+#define SPARKLE_CHANCE 16
+
+// width of larson scanner's glow on each side, in pixels
+#define LARSON_WIDTH 3
+
+// 128 + 127.5 * sin(2 pi i / 256), rounded
+static const uint8_t sine_table[256] = {
+    128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+    176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+    176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+     79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+     37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+     10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+      0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+     10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+     37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+     79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+};
+
+// hue wheel: red to green to blue and back to red, each color rising as the one before falls
+#define HUE_RED(h) ((h) < 85 ? 255 - (h) * 3 : (h) < 170 ? 0 : ((h) - 170) * 3)
+#define HUE_GREEN(h) ((h) < 85 ? (h) * 3 : (h) < 170 ? 255 - ((h) - 85) * 3 : 0)
+#define HUE_BLUE(h) ((h) < 85 ? 0 : (h) < 170 ? ((h) - 85) * 3 : 255 - ((h) - 170) * 3)
+#define HUE(h) { HUE_RED(h), HUE_GREEN(h), HUE_BLUE(h) }
+#define HUE_4(h) HUE(h), HUE((h) + 1), HUE((h) + 2), HUE((h) + 3)
+#define HUE_16(h) HUE_4(h), HUE_4((h) + 4), HUE_4((h) + 8), HUE_4((h) + 12)
+#define HUE_64(h) HUE_16(h), HUE_16((h) + 16), HUE_16((h) + 32), HUE_16((h) + 48)
+
+static const uint8_t hue_table[256][3] = {
+    HUE_64(0), HUE_64(64), HUE_64(128), HUE_64(192)
+};
+
+static uint32_t random_state = 0;
+
+// time set by set_effect_clock(), or -1 to use monotonic clock
+static int64_t effect_clock = -1;
+
+void set_effect_clock(int64_t msec)
+{
+    effect_clock = msec;
+}
+
+static int64_t now_ms(void)
+{
+    return effect_clock >= 0 ? effect_clock : now_ns() / 1000000;
+}
+
+// xorshift; good enough for sparkles
+static uint32_t next_random(void)
+{
+    if (random_state == 0) random_state = (uint32_t)now_ms() | 1;
+
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// pixel index for position counted from left end of board
+static int pixel_at(Flags flags, int position)
+{
+    return flags.left_to_right ? position : profile.num_pixels - 1 - position;
+}
+
+// color scaled by level 0-255
+static void set_level(Pixel *pixel, Pixel color, int level)
+{
+    pixel->red = (color.red * level + 127) / 255;
+    pixel->green = (color.green * level + 127) / 255;
+    pixel->blue = (color.blue * level + 127) / 255;
+}
+
+bool run_effect(const char *name, Flags flags, uint8_t select_mask, Pixel color, int period,
+                Pixel pixels[])
+{
+    int n = profile.num_pixels;
+    int64_t t = now_ms();
+    int p;
+
+    if (strcmp(name, "rainbow") == 0) {
+        // hue wheel spread across board, turning once per period
+        int turn;
+
+        if (period <= 0) period = RAINBOW_PERIOD;
+        turn = (t % period) * 256 / period;
+
+        for (p = 0; p < n; p++) {
+            int k = pixel_at(flags, p);
+            const uint8_t *rgb = hue_table[(p * 256 / n + turn) & 0xFF];
+
+            if (pixel_selected(select_mask, k)) {
+                pixels[k].red = rgb[0];
+                pixels[k].green = rgb[1];
+                pixels[k].blue = rgb[2];
+            }
+        }
+
+    } else if (strcmp(name, "breathe") == 0) {
+        // rise and fall smoothly, starting dark
+        int level;
+
+        if (period <= 0) period = BREATHE_PERIOD;
+        level = sine_table[((t % period) * 256 / period + 192) & 0xFF];
+
+        for (p = 0; p < n; p++) {
+            if (pixel_selected(select_mask, p)) set_level(&pixels[p], color, level);
+        }
+
+    } else if (strcmp(name, "chase") == 0) {
+        // one pixel runs from left to right once per period
+        int lit;
+
+        if (period <= 0) period = CHASE_PERIOD;
+        lit = (t % period) * n / period;
+
+        for (p = 0; p < n; p++) {
+            int k = pixel_at(flags, p);
+            if (pixel_selected(select_mask, k)) set_level(&pixels[k], color, p == lit ? 255 : 0);
+        }
+
+    } else if (strcmp(name, "larson") == 0) {
+        // glow sweeps left to right and back once per period; positions in 8.8 fixed point
+        int64_t phase;
+        int center;
+
+        if (period <= 0) period = LARSON_PERIOD;
+        phase = (t % period) * 2 * ((n - 1) << 8) / period;
+        center = phase <= (n - 1) << 8 ? phase : 2 * ((n - 1) << 8) - phase;
+
+        for (p = 0; p < n; p++) {
+            int k = pixel_at(flags, p);
+            int distance = abs((p << 8) - center);
+            int level = distance >= LARSON_WIDTH << 8 ? 0 :
+                        255 - distance * 255 / (LARSON_WIDTH << 8);
+
+            if (pixel_selected(select_mask, k)) set_level(&pixels[k], color, level);
+        }
+
+    } else if (strcmp(name, "sparkle") == 0) {
+        // each frame, light a few pixels at random and fade the rest by an eighth
+        int chance = period > 0 ? period : SPARKLE_CHANCE;
+
+        for (p = 0; p < n; p++) {
+            if (!pixel_selected(select_mask, p)) continue;
+
+            if ((int)(next_random() & 0xFF) < chance) {
+                set_level(&pixels[p], color, 255);
+
+            } else {
+                pixels[p].red -= (pixels[p].red + 7) / 8;
+                pixels[p].green -= (pixels[p].green + 7) / 8;
+                pixels[p].blue -= (pixels[p].blue + 7) / 8;
+            }
+        }
+
+    } else if (strcmp(name, "wipe") == 0) {
+        // fill from left to right over a period, then start again from dark
+        int filled;
+
+        if (period <= 0) period = WIPE_PERIOD;
+        filled = (t % period) * (n + 1) / period;
+
+        for (p = 0; p < n; p++) {
+            int k = pixel_at(flags, p);
+            if (pixel_selected(select_mask, k)) set_level(&pixels[k], color, p < filled ? 255 : 0);
+        }
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
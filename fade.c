@@ -0,0 +1,167 @@
+//
+// fade.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// fades run as many frames as the backend can send, up to FADE_MAX_FPS. Each frame's position is
+// taken from the clock, so a slow backend gives fewer, larger steps but the fade still ends on time.
+// Interpolation is 16.16 fixed point, so no floating point is needed per pixel. A fade command
+// sets pixels to the target at once; the frames in between are sent by play_fade(), right away or,
+// with defer_fades, when the caller is ready, so blinkt can save state first and blinktd can step
+// the fade from its poll loop.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fade.h"
+#include "timing.h"
+
+#define FIX_SHIFT 16
+#define FIX_ONE (1 << FIX_SHIFT)
+
+bool defer_fades = false;
+
+// fade in progress
+static bool fading = false;
+static unsigned long fades_begun = 0;
+static Pixel *fade_from = NULL;
+static Pixel *fade_to = NULL;
+static int64_t fade_start;
+static int64_t fade_duration;
+static Curve fade_curve;
+
+// time set by set_fade_clock(), or -1 to use monotonic clock
+static int64_t fade_clock = -1;
+
+void set_fade_clock(int64_t msec)
+{
+    fade_clock = msec;
+}
+
+static int64_t fade_time(void)
+{
+    return fade_clock >= 0 ? fade_clock * 1000000 : now_ns();
+}
+
+// smoothstep: 3f^2 - 2f^3
+static uint32_t ease(uint32_t f)
+{
+    uint64_t f2 = ((uint64_t)f * f) >> FIX_SHIFT;
+    return (f2 * (3 * FIX_ONE - 2 * f)) >> FIX_SHIFT;
+}
+
+static uint8_t tween(uint8_t from, uint8_t to, uint32_t f)
+{
+    return (from * (FIX_ONE - f) + to * f + FIX_ONE / 2) >> FIX_SHIFT;
+}
+
+void fade_pixels(Flags flags, Pixel pixels[], const Pixel target[], int msec, Curve curve)
+{
+    stop_fade();
+
+    if (flags.holding || msec <= 0) {
+        memcpy(pixels, target, profile.num_pixels * sizeof(Pixel));
+        return;
+    }
+
+    fade_from = alloc_pixels();
+    fade_to = alloc_pixels();
+    memcpy(fade_from, pixels, profile.num_pixels * sizeof(Pixel));
+    memcpy(fade_to, target, profile.num_pixels * sizeof(Pixel));
+    fade_start = fade_time();
+    fade_duration = msec * (int64_t)1000000;
+    fade_curve = curve;
+    fading = true;
+    fades_begun++;
+
+    memcpy(pixels, target, profile.num_pixels * sizeof(Pixel));
+
+    if (!defer_fades) play_fade(flags, NULL);
+}
+
+bool fade_running(void)
+{
+    return fading;
+}
+
+unsigned long fades_started(void)
+{
+    return fades_begun;
+}
+
+bool fade_frame(Pixel pixels[])
+{
+    int64_t elapsed = fade_time() - fade_start;
+    uint32_t f;
+    int k;
+
+    if (!fading) return false;
+
+    if (elapsed >= fade_duration) {
+        memcpy(pixels, fade_to, profile.num_pixels * sizeof(Pixel));
+        stop_fade();
+        return false;
+    }
+
+    f = (elapsed << FIX_SHIFT) / fade_duration;
+    if (fade_curve == CURVE_EASE) f = ease(f);
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        pixels[k].brightness = tween(fade_from[k].brightness, fade_to[k].brightness, f);
+        pixels[k].red = tween(fade_from[k].red, fade_to[k].red, f);
+        pixels[k].green = tween(fade_from[k].green, fade_to[k].green, f);
+        pixels[k].blue = tween(fade_from[k].blue, fade_to[k].blue, f);
+    }
+
+    return true;
+}
+
+void play_fade(Flags flags, bool (*cancelled)(void))
+{
+    Pixel *frame = alloc_pixels();
+    int64_t start = now_ns();
+    long count;
+
+    for (count = 1; fade_frame(frame); count++) {
+        write_to_blinkt(flags, frame);
+        if (cancelled != NULL && cancelled()) break;
+
+        // don't spin faster than FADE_MAX_FPS on a fast backend
+        if (!sleep_until(start + count * (1000000000 / FADE_MAX_FPS))) break;
+    }
+
+    stop_fade();
+    free(frame);
+}
+
+void stop_fade(void)
+{
+    free(fade_from);
+    free(fade_to);
+    fade_from = NULL;
+    fade_to = NULL;
+    fading = false;
+}
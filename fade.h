@@ -0,0 +1,66 @@
+//
+// fade.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef fade_h
+#define fade_h
+
+#include <stdbool.h>
+
+#include "blinkt.h"
+
+// how fade moves from start to end
+typedef enum {
+    CURVE_LINEAR,
+    CURVE_EASE,     // slow at start and end
+} Curve;
+
+#define FADE_MAX_FPS 1000
+
+// if true, fade_pixels() only starts fade, and caller sends its frames
+extern bool defer_fades;
+
+// fade pixels from current values to target over msec; pixels are set to target at once, and
+// frames in between are sent now, or later by caller if defer_fades is set
+void fade_pixels(Flags flags, Pixel pixels[], const Pixel target[], int msec, Curve curve);
+
+// true if fade has been started and not finished or stopped
+bool fade_running(void);
+
+// count of fades started, so caller can tell whether a command started one
+unsigned long fades_started(void);
+
+// set pixels to fade's position now; false once fade is over, leaving pixels at its target
+bool fade_frame(Pixel pixels[]);
+
+// send frames of fade until it is over or cancelled returns true; cancelled may be NULL
+void play_fade(Flags flags, bool (*cancelled)(void));
+
+// forget fade in progress
+void stop_fade(void);
+
+// time fades at msec instead of current time, e.g. when compiling an animation; -1 to undo
+void set_fade_clock(int64_t msec);
+
+#endif /* fade_h */
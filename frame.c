@@ -0,0 +1,221 @@
+//
+// frame.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+
+// edge for one bit, given the bit sent before it
+#define BIT(x, i) (((x) >> (i)) & 1)
+#define EDGE(bit, prev) ((bit) == (prev) ? EDGE_CLK : (bit) ? EDGE_DAT1_CLK : EDGE_DAT0_CLK)
+
+#define BYTE_EDGES(s, x) { \
+    EDGE(BIT(x, 7), (s)),       EDGE(BIT(x, 6), BIT(x, 7)), \
+    EDGE(BIT(x, 5), BIT(x, 6)), EDGE(BIT(x, 4), BIT(x, 5)), \
+    EDGE(BIT(x, 3), BIT(x, 4)), EDGE(BIT(x, 2), BIT(x, 3)), \
+    EDGE(BIT(x, 1), BIT(x, 2)), EDGE(BIT(x, 0), BIT(x, 1)) }
+
+#define EDGES_4(s, x) \
+    BYTE_EDGES(s, (x)), BYTE_EDGES(s, (x) + 1), BYTE_EDGES(s, (x) + 2), BYTE_EDGES(s, (x) + 3)
+#define EDGES_16(s, x) \
+    EDGES_4(s, (x)), EDGES_4(s, (x) + 4), EDGES_4(s, (x) + 8), EDGES_4(s, (x) + 12)
+#define EDGES_64(s, x) \
+    EDGES_16(s, (x)), EDGES_16(s, (x) + 16), EDGES_16(s, (x) + 32), EDGES_16(s, (x) + 48)
+#define EDGES_256(s) \
+    EDGES_64(s, 0), EDGES_64(s, 64), EDGES_64(s, 128), EDGES_64(s, 192)
+
+const Edge byte_edges[2][256][8] = {
+    { EDGES_256(0) },
+    { EDGES_256(1) }
+};
+
+// gamma 2.2 correction in 8.8 fixed point: round(255 * 256 * (i / 255) ^ 2.2). The fraction is
+// carried from frame to frame by dithering, so dim levels between two steps are still reachable.
+static const uint16_t gamma_table[256] = {
+        0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,
+       78,    94,   110,   128,   148,   169,   191,   216,   241,   269,   298,   328,
+      360,   394,   430,   467,   506,   547,   589,   633,   679,   726,   776,   827,
+      880,   934,   991,  1049,  1109,  1171,  1235,  1300,  1368,  1437,  1508,  1581,
+     1656,  1733,  1812,  1893,  1975,  2060,  2146,  2235,  2325,  2417,  2512,  2608,
+     2706,  2806,  2908,  3013,  3119,  3227,  3337,  3450,  3564,  3680,  3798,  3919,
+     4041,  4166,  4292,  4421,  4552,  4685,  4819,  4956,  5096,  5237,  5380,  5525,
+     5673,  5823,  5974,  6128,  6284,  6442,  6603,  6765,  6930,  7097,  7266,  7437,
+     7610,  7786,  7963,  8143,  8325,  8509,  8696,  8885,  9075,  9268,  9464,  9661,
+     9861, 10063, 10267, 10474, 10682, 10893, 11107, 11322, 11540, 11760, 11982, 12207,
+    12433, 12663, 12894, 13128, 13363, 13602, 13842, 14085, 14330, 14578, 14827, 15080,
+    15334, 15591, 15850, 16111, 16375, 16641, 16909, 17180, 17453, 17729, 18006, 18287,
+    18569, 18854, 19141, 19431, 19723, 20017, 20314, 20613, 20915, 21218, 21525, 21833,
+    22144, 22458, 22774, 23092, 23413, 23736, 24062, 24390, 24720, 25053, 25388, 25726,
+    26066, 26408, 26753, 27101, 27451, 27803, 28158, 28515, 28875, 29237, 29602, 29969,
+    30338, 30710, 31085, 31462, 31841, 32223, 32608, 32995, 33384, 33776, 34170, 34567,
+    34967, 35369, 35773, 36180, 36589, 37001, 37416, 37833, 38252, 38674, 39099, 39526,
+    39956, 40388, 40823, 41260, 41700, 42142, 42587, 43034, 43484, 43937, 44392, 44849,
+    45310, 45772, 46238, 46706, 47176, 47649, 48125, 48603, 49084, 49567, 50053, 50542,
+    51033, 51526, 52023, 52522, 53023, 53527, 54034, 54543, 55055, 55570, 56087, 56607,
+    57129, 57654, 58182, 58712, 59245, 59780, 60318, 60859, 61402, 61948, 62497, 63048,
+    63602, 64159, 64718, 65280,
+};
+
+// fractional part left over from previous frame, per color channel
+static uint8_t *dither_error = NULL;
+static int dither_pixels = 0;
+
+// each LED delays data by half a clock, so end frame needs half a clock per pixel to push data
+// to the last one. 32 more clocks allow for LEDs that only update on the following frame.
+int end_frame_edges(void)
+{
+    return 32 + (profile.num_pixels + 1) / 2;
+}
+
+int frame_bytes(void)
+{
+    return START_FRAME_BYTES + PIXEL_BYTES * profile.num_pixels + (end_frame_edges() + 7) / 8;
+}
+
+int frame_edges(void)
+{
+    return START_FRAME_EDGES + 8 * PIXEL_BYTES * profile.num_pixels + end_frame_edges();
+}
+
+// color value to send for channel, after gamma correction and dithering
+static uint8_t correct(int channel, uint8_t value)
+{
+    unsigned int level = gamma_table[value];
+
+    if (!profile.dither) return (level + 0x80) >> 8;
+
+    // carry fraction into next frame; starting at one half rounds a single frame to nearest
+    level += dither_error[channel];
+    dither_error[channel] = level & 0xFF;
+    return level >> 8;
+}
+
+void reset_dither(void)
+{
+    free(dither_error);
+    dither_error = NULL;
+    dither_pixels = 0;
+}
+
+// size dithering for profile before building a frame
+static void prepare_dither(void)
+{
+    if (profile.gamma && profile.dither && dither_pixels != profile.num_pixels) {
+        reset_dither();
+        dither_error = malloc(3 * profile.num_pixels);
+        if (dither_error == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        memset(dither_error, 0x80, 3 * profile.num_pixels);
+        dither_pixels = profile.num_pixels;
+    }
+}
+
+// store one pixel in wire order at p, after gamma correction; return where next pixel goes
+static uint8_t *put_pixel(uint8_t *p, int k, uint8_t brightness,
+                          uint8_t red, uint8_t green, uint8_t blue)
+{
+    uint8_t colors[3];
+
+    colors[0] = red;
+    colors[1] = green;
+    colors[2] = blue;
+
+    if (profile.gamma) {
+        colors[0] = correct(3 * k, colors[0]);
+        colors[1] = correct(3 * k + 1, colors[1]);
+        colors[2] = correct(3 * k + 2, colors[2]);
+    }
+
+    *p++ = brightness | 0b11100000;
+    *p++ = colors[profile.order[0]];
+    *p++ = colors[profile.order[1]];
+    *p++ = colors[profile.order[2]];
+    return p;
+}
+
+// build complete frame as it goes out on the wire, most significant bit first.
+// e.g. 8 pixels cleared gives 00 00 00 00, then E7 00 00 00 eight times, then 00 00 00 00 00
+void build_frame(Flags flags, const Pixel pixels[], uint8_t *frame)
+{
+    uint8_t *p = frame + START_FRAME_BYTES;
+    uint8_t *end = frame + frame_bytes();
+    int k;
+
+    memset(frame, 0, START_FRAME_BYTES);
+    prepare_dither();
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        uint8_t brightness = flags.leds_on ? pixels[k].brightness : 0;
+        if (flags.binary_on && !pixel_selected(flags.binary_mask, k)) brightness = 0;
+
+        p = put_pixel(p, k, brightness, pixels[k].red, pixels[k].green, pixels[k].blue);
+    }
+
+    memset(p, 0, end - p);
+}
+
+void build_raw_frame(const uint8_t *raw, int bytes_per_pixel, uint8_t brightness, uint8_t *frame)
+{
+    uint8_t *p = frame + START_FRAME_BYTES;
+    uint8_t *end = frame + frame_bytes();
+    int k;
+
+    memset(frame, 0, START_FRAME_BYTES);
+    prepare_dither();
+
+    for (k = 0; k < profile.num_pixels; k++, raw += bytes_per_pixel) {
+        if (bytes_per_pixel == 4) brightness = raw[3] >> 3;
+        p = put_pixel(p, k, brightness, raw[0], raw[1], raw[2]);
+    }
+
+    memset(p, 0, end - p);
+}
+
+// convert frame to edge sequence for a backend to replay.
+// start frame always sets data pin low; after that, data pin is written only when it changes
+void encode_edges(const uint8_t *frame, Edge *edges)
+{
+    Edge *e = edges;
+    int data_state = 0;
+    int k;
+
+    // start frame
+    *e++ = EDGE_DAT0_CLK;
+    memset(e, EDGE_CLK, START_FRAME_EDGES - 1);
+    e += START_FRAME_EDGES - 1;
+
+    for (k = START_FRAME_BYTES; k < START_FRAME_BYTES + PIXEL_BYTES * profile.num_pixels; k++) {
+        memcpy(e, byte_edges[data_state][frame[k]], 8);
+        e += 8;
+        data_state = frame[k] & 1;
+    }
+
+    // end frame
+    *e++ = data_state ? EDGE_DAT0_CLK : EDGE_CLK;
+    memset(e, EDGE_CLK, end_frame_edges() - 1);
+}
@@ -0,0 +1,65 @@
+//
+// frame.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef frame_h
+#define frame_h
+
+#include <stdint.h>
+
+#include "blinkt.h"
+
+// APA102 frame layout: 32 zero bits, 4 bytes per pixel, then an end frame of zero bits
+#define START_FRAME_BYTES 4
+#define START_FRAME_EDGES 32
+#define PIXEL_BYTES 4
+
+// one clock pulse, preceded by a data pin write only if the data value changes
+#define EDGE_CLK 0          // pulse clock, data pin unchanged
+#define EDGE_DAT0_CLK 1     // set data pin low, then pulse clock
+#define EDGE_DAT1_CLK 2     // set data pin high, then pulse clock
+typedef uint8_t Edge;
+
+// edge sequence for each byte, indexed by data pin state before the byte, then byte value
+extern const Edge byte_edges[2][256][8];
+
+// frame sizes for current profile
+int end_frame_edges(void);
+int frame_bytes(void);
+int frame_edges(void);
+
+// build complete frame as it goes out on the wire, most significant bit first
+void build_frame(Flags flags, const Pixel pixels[], uint8_t *frame);
+
+// build frame from raw pixels in chain order: red, green, blue bytes, then with bytes_per_pixel 4,
+// a brightness byte 0-255 that replaces brightness (0-31)
+void build_raw_frame(const uint8_t *raw, int bytes_per_pixel, uint8_t brightness, uint8_t *frame);
+
+// forget dithering carried between frames
+void reset_dither(void);
+
+// convert frame to edge sequence for a backend to replay
+void encode_edges(const uint8_t *frame, Edge *edges);
+
+#endif /* frame_h */
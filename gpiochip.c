@@ -0,0 +1,144 @@
+//
+// gpiochip.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Linux GPIO character device (GPIO_V2 ioctls). Needs no daemon and no root; access to the
+// chip device (usually the gpio group) is enough. Works with the gpio-sim test module.
+
+#include "backend.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+// default GPIO character device; Raspberry Pi header pins are on gpiochip0 before the Pi 5
+#define GPIOCHIP_PATH "/dev/gpiochip0"
+
+// bit positions of each line within the request
+#define DAT_BIT 1
+#define CLK_BIT 2
+
+static int line_fd = -1;
+
+// request data and clock lines as outputs, both low
+static bool gpiochip_init(void)
+{
+    struct gpio_v2_line_request request;
+    const char *path = getenv("BLINKT_GPIOCHIP");
+    int chip_fd;
+
+    if (path == NULL) path = GPIOCHIP_PATH;
+
+    chip_fd = open(path, O_RDWR);
+
+    if (chip_fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = profile.dat;
+    request.offsets[1] = profile.clk;
+    request.num_lines = 2;
+    strncpy(request.consumer, "blinkt", sizeof(request.consumer) - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    request.config.num_attrs = 1;
+    request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    request.config.attrs[0].attr.values = 0;
+    request.config.attrs[0].mask = DAT_BIT | CLK_BIT;
+
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        perror(path);
+        close(chip_fd);
+        return false;
+    }
+
+    // line request stays valid after chip is closed
+    close(chip_fd);
+    line_fd = request.fd;
+
+    return true;
+}
+
+static void gpiochip_close(void)
+{
+    if (line_fd >= 0) {
+        close(line_fd);
+        line_fd = -1;
+    }
+}
+
+static void set_lines(uint64_t mask, uint64_t bits)
+{
+    struct gpio_v2_line_values values;
+    values.mask = mask;
+    values.bits = bits;
+    ioctl(line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+    frame_round_trips++;
+}
+
+// LEDs latch data on rising clock, so data for the next bit can change together with the
+// falling clock of the previous one
+static void gpiochip_write_edges(const Edge *edges, int count)
+{
+    int i;
+
+    if (count > 0 && edges[0] != EDGE_CLK) {
+        set_lines(DAT_BIT, edges[0] == EDGE_DAT1_CLK ? DAT_BIT : 0);
+    }
+
+    for (i = 0; i < count; i++) {
+        set_lines(CLK_BIT, CLK_BIT);
+
+        if (i + 1 < count && edges[i + 1] != EDGE_CLK) {
+            set_lines(DAT_BIT | CLK_BIT, edges[i + 1] == EDGE_DAT1_CLK ? DAT_BIT : 0);
+
+        } else {
+            set_lines(CLK_BIT, 0);
+        }
+    }
+}
+
+static void gpiochip_flush(void)
+{
+}
+
+static void gpiochip_report(FILE *out)
+{
+    fprintf(out, "GPIO line updates per frame: %d\n", frame_round_trips);
+}
+
+const Backend gpiod_backend = {
+    "gpiod", gpiochip_init, gpiochip_write_edges, NULL, gpiochip_flush, gpiochip_close,
+    gpiochip_report
+};
+
+#endif
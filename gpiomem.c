@@ -0,0 +1,213 @@
+//
+// gpiomem.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// BCM2835/BCM2711 GPIO registers mapped through /dev/gpiomem (Pi 4 and earlier). Needs no root
+// beyond the gpio group, no daemon, and no library threads; each edge is a single store.
+//
+// For testing, BLINKT_GPIOMEM may name a regular file instead. The file is mapped in place of the
+// register block; set and clear writes are applied to the level register and fed to the
+// simulated LED chain in sim.c.
+
+#include "backend.h"
+#include "sim.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define GPIOMEM_PATH "/dev/gpiomem"
+#define GPIOMEM_SIZE 4096
+
+// register offsets in 32-bit words
+#define GPFSEL0 0
+#define GPSET0 7
+#define GPCLR0 10
+#define GPLEV0 13
+
+static volatile uint32_t *gpio_regs = NULL;
+static uint32_t dat_mask;          // pin bits in set, clear, and level registers
+static uint32_t clk_mask;
+static bool gpiomem_file = false;  // true if mapping a regular file instead of real registers
+
+// apply set and clear to level register, and feed rising clock to simulated chain
+static void emulate_write(void)
+{
+    uint32_t old_level = gpio_regs[GPLEV0];
+    uint32_t level = (old_level | gpio_regs[GPSET0]) & ~gpio_regs[GPCLR0];
+
+    gpio_regs[GPSET0] = 0;
+    gpio_regs[GPCLR0] = 0;
+    gpio_regs[GPLEV0] = level;
+    frame_round_trips++;
+
+    if ((level & clk_mask) && !(old_level & clk_mask)) sim_clock((level & dat_mask) != 0);
+}
+
+static void set_output(unsigned gpio)
+{
+    int word = GPFSEL0 + gpio / 10;
+    int shift = (gpio % 10) * 3;
+
+    gpio_regs[word] = (gpio_regs[word] & ~(7u << shift)) | (1u << shift);
+}
+
+static bool gpiomem_init(void)
+{
+    const char *path = getenv("BLINKT_GPIOMEM");
+    struct stat statbuf;
+    void *map;
+    int fd;
+
+    // set and clear registers cover GPIO 0-31 only
+    if (profile.dat > 31 || profile.clk > 31) {
+        fprintf(stderr, "gpiomem backend needs GPIO 0 to 31\n");
+        return false;
+    }
+
+    dat_mask = 1u << profile.dat;
+    clk_mask = 1u << profile.clk;
+
+    if (path != NULL) {
+        // may be a test file that does not exist yet
+        fd = open(path, O_RDWR | O_CREAT, 0666);
+
+    } else {
+        path = GPIOMEM_PATH;
+        fd = open(path, O_RDWR | O_SYNC);
+    }
+
+
+    if (fd < 0 || fstat(fd, &statbuf) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    gpiomem_file = S_ISREG(statbuf.st_mode);
+    if (gpiomem_file && statbuf.st_size < GPIOMEM_SIZE && ftruncate(fd, GPIOMEM_SIZE) != 0) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, GPIOMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+
+    gpio_regs = map;
+    if (gpiomem_file) sim_reset();
+
+    gpio_regs[GPCLR0] = dat_mask | clk_mask;
+    if (gpiomem_file) emulate_write();
+
+    set_output(profile.dat);
+    set_output(profile.clk);
+
+    return true;
+}
+
+static void gpiomem_write_edges(const Edge *edges, int count)
+{
+    int writes = 0;
+    int i;
+
+    if (gpiomem_file) {
+        for (i = 0; i < count; i++) {
+            if (edges[i] != EDGE_CLK) {
+                gpio_regs[edges[i] == EDGE_DAT1_CLK ? GPSET0 : GPCLR0] = dat_mask;
+                emulate_write();
+                sim_counts.data_writes++;
+            }
+
+            gpio_regs[GPSET0] = clk_mask;
+            emulate_write();
+            gpio_regs[GPCLR0] = clk_mask;
+            emulate_write();
+        }
+
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (edges[i] != EDGE_CLK) {
+            gpio_regs[edges[i] == EDGE_DAT1_CLK ? GPSET0 : GPCLR0] = dat_mask;
+            writes++;
+        }
+
+        // reading level register waits for posted write to reach pin, which also keeps clock
+        // rate within what the LEDs accept on fast Pi models
+        gpio_regs[GPSET0] = clk_mask;
+        (void)gpio_regs[GPLEV0];
+        gpio_regs[GPCLR0] = clk_mask;
+        (void)gpio_regs[GPLEV0];
+    }
+
+    // register writes, counted once rather than per edge to keep the loop tight
+    frame_round_trips += writes + 2 * count;
+}
+
+static void gpiomem_flush(void)
+{
+    if (gpiomem_file) {
+        sim_counts.frames++;
+        msync((void *)gpio_regs, GPIOMEM_SIZE, MS_ASYNC);
+    }
+}
+
+static void gpiomem_close(void)
+{
+    if (gpio_regs != NULL) {
+        munmap((void *)gpio_regs, GPIOMEM_SIZE);
+        gpio_regs = NULL;
+    }
+}
+
+static void gpiomem_report(FILE *out)
+{
+    if (gpiomem_file) {
+        fprintf(out, "decoded from register file: ");
+        sim_backend.report(out);
+
+    } else {
+        fprintf(out, "GPIO register writes per frame: %d\n", frame_round_trips);
+    }
+}
+
+const Backend gpiomem_backend = {
+    "gpiomem", gpiomem_init, gpiomem_write_edges, NULL, gpiomem_flush, gpiomem_close,
+    gpiomem_report
+};
+
+#endif
@@ -33,306 +33,112 @@
 #include <string.h>
 
 #include "blinkt.h"
-#include "text.h"
-
-struct Color {
+#include "blinktd.h"
+#include "command.h"
+#include "dmx.h"
+#include "meter.h"
+#include "opc.h"
+#include "play.h"
+#include "script.h"
+#include "stats.h"
+#include "stream.h"
+#include "timing.h"
+#include "update.h"
+
+struct Mode {
     const char *name;
-    uint8_t red;
-    uint8_t green;
-    uint8_t blue;
+    int (*run)(int argc, const char *argv[]);
+    bool needs_gpio;            // drives LEDs itself, so cannot share them with blinktd
+};
+typedef struct Mode Mode;
+
+// modes, sorted by name for bsearch
+static const Mode modes[] = {
+    { "animate", run_animation, false },
+    { "compile", compile_script, false },
+    { "dmx", run_dmx_receiver, true },
+    { "meter", run_meter, true },
+    { "opc", run_opc_server, true },
+    { "play", play_animation, true },
+    { "stats", run_stats, false },
+    { "stream", run_stream, true },
 };
-typedef struct Color Color;
-
-#define FILE_PATH "/usr/local/share/blinkt"
-
-int main(int argc, const char * argv[]) {
-    Pixel previous_pixels[NUM_PIXELS];
-    Flags previous_flags;
-    Pixel pixels[NUM_PIXELS];
-    Flags flags;
-    int k;
-    int next_arg = 1;
-    uint8_t select_mask = 0xFF; // default is to change all pixels
-
-    // intialize GPIO library and pins
-    init_gpio();
-
-    // initialize data structures
-    init_state(&flags, pixels);
 
-    // read state file if present; OK if does not exist
-    read_state_file(FILE_PATH, &flags, pixels);
+static int compare_mode(const void *name, const void *mode)
+{
+    return strcmp(name, ((const Mode *)mode)->name);
+}
 
-    copy_state(&flags, pixels, &previous_flags, previous_pixels);
+static void print_timing(void)
+{
+    report_timing(stderr);
+}
 
-    // read selection option, if present
-    if (next_arg < argc && is_num_arg(argv[next_arg])) {
-        select_mask = parse_num(argv[next_arg], 2);
-        if (flags.left_to_right) select_mask = swap_bits(select_mask);
-        next_arg++;
+int main(int argc, const char * argv[]) {
+    const char *profile_path = getenv("BLINKT_PROFILE");
+    bool changed = false;
+    int first, end;
+    int delay;
+
+    start_timing();
+
+    // blinkt --timing <command> reports where the time went
+    if (argc > 1 && strcmp(argv[1], "--timing") == 0) {
+        timing_on = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+        atexit(print_timing);
     }
 
-    // test next arg
-    if (next_arg < argc) {
-        if (strcmp(argv[next_arg], "off") == 0) {
-            flags.leds_on = false;
-
-        } else if (strcmp(argv[next_arg], "on") == 0) {
-            flags.leds_on = true;
-            flags.holding = false;
-
-        } else if (strcmp(argv[next_arg], "left") == 0) {
-            flags.left_to_right = true;
-
-        } else if (strcmp(argv[next_arg], "right") == 0) {
-            flags.left_to_right = false;
-
-        } else if (strcmp(argv[next_arg], "hold") == 0) {
-            flags.holding = true;
-
-        } else if (strcmp(argv[next_arg], "show") == 0) {
-            flags.holding = false;
-
-        } else if (strcmp(argv[next_arg], "clear") == 0) {
-            // reset everything except left_to_right flag
-            flags.leds_on = true;
-            flags.holding = false;
-            flags.binary_on = false;
-            flags.binary_mask = 0xFF;
-            clear_pixels(pixels);
-
-        } else if (strcmp(argv[next_arg], "bright") == 0) {
-            if (++next_arg < argc) {
-                int brightness = parse_num(argv[next_arg], 10);
-
-                if (brightness < 0 || brightness > 31) {
-                    fprintf(stderr, "Brightness must be 0 to 31\n");
-
-                } else {
-                    for (k = 0; k < NUM_PIXELS; k++) {
-                        if ((select_mask & (1 << k)) != 0) pixels[k].brightness = brightness;
-                    }
-                }
-            }
-
-        } else if (strcmp(argv[next_arg], "rgb") == 0) {
-            int red = 0;
-            int green = 0;
-            int blue = 0;
-
-            if (++next_arg < argc) red = parse_num(argv[next_arg], 10);
-            if (++next_arg < argc) green = parse_num(argv[next_arg], 10);
-            if (++next_arg < argc) blue = parse_num(argv[next_arg], 10);
-
-            if (red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 || blue > 255) {
-                fprintf(stderr, "red green blue values must be 0 to 255\n");
-
-            } else {
-                for (k = 0; k < NUM_PIXELS; k++) {
-                    if ((select_mask & (1 << k)) != 0) {
-                        pixels[k].red = red;
-                        pixels[k].green = green;
-                        pixels[k].blue = blue;
-                    }
-                }
-            }
-
-        } else if (strcmp(argv[next_arg], "binary") == 0) {
-            if (++next_arg < argc) {
-                if (strcmp(argv[next_arg], "off") == 0) {
-                    flags.binary_on = false;
-
-                } else {
-                    flags.binary_on = true;
-                    flags.binary_mask = parse_num(argv[next_arg], 10);
-                    if (flags.left_to_right) flags.binary_mask = swap_bits(flags.binary_mask);
-                    flags.binary_mask |= ~select_mask;
-                }
-            }
-
-        } else if (strcmp(argv[next_arg], "delay") == 0) {
-            if (++next_arg < argc) {
-                int msec = atoi(argv[next_arg]);
-                sleep_msec(msec);
-            }
-
-        } else if (strcmp(argv[next_arg], "rotate") == 0) {
-            if (++next_arg < argc) {
-                const char *option = argv[next_arg];
-                if (flags.binary_on) {
-                    // if in binary mode, rotate binary mask instead of pixel settings
-                    if (strcmp(option, "in") == 0) {
-                        uint8_t left_mask = flags.binary_mask >> 4;
-                        uint8_t right_mask = flags.binary_mask & 0xF;
+    // blinkt -f script, or blinkt - to read commands from standard input
+    if (argc == 3 && strcmp(argv[1], "-f") == 0) return run_script(argv[2]);
+    if (argc == 2 && strcmp(argv[1], "-") == 0) return run_script("-");
 
-                        left_mask = ((left_mask >> 1) | (left_mask << 3)) & 0xF;;
-                        right_mask = ((right_mask << 1) | (right_mask >> 3)) & 0xF;
+    // modes that take over the whole command line
+    if (argc > 1) {
+        const Mode *mode = bsearch(argv[1], modes, sizeof(modes) / sizeof(modes[0]), sizeof(Mode),
+                                   compare_mode);
 
-                        flags.binary_mask = (left_mask << 4) | right_mask;
-
-                    } else if (strcmp(option, "out") == 0) {
-                        uint8_t left_mask = flags.binary_mask >> 4;
-                        uint8_t right_mask = flags.binary_mask & 0xF;
-
-                        left_mask = ((left_mask << 1) | (left_mask >> 3)) & 0xF;
-                        right_mask = ((right_mask >> 1) | (right_mask << 3)) & 0xF;;
-
-                        flags.binary_mask = (left_mask << 4) | right_mask;
-
-                    } else if (strcmp(option, "left") == 0) {
-                        flags.binary_mask = (flags.binary_mask << 1) | (flags.binary_mask >> 7);
-
-                    } else if (strcmp(option, "right") == 0) {
-                        flags.binary_mask = (flags.binary_mask >> 1) | (flags.binary_mask << 7);
-                    }
-
-                } else {
-                    // rotate pixel settings
-                    int shift = 0;
-                    if (strcmp(option, "in") == 0) {
-                        // from outside to center
-                        Pixel temp = pixels[0];
-                        pixels[0] = pixels[3];
-                        pixels[3] = pixels[2];
-                        pixels[2] = pixels[1];
-                        pixels[1] = temp;
-
-                        temp = pixels[7];
-                        pixels[7] = pixels[4];
-                        pixels[4] = pixels[5];
-                        pixels[5] = pixels[6];
-                        pixels[6] = temp;
-
-                    } else if (strcmp(option, "out") == 0) {
-                        // from center to outside
-                        Pixel temp = pixels[0];
-                        pixels[0] = pixels[1];
-                        pixels[1] = pixels[2];
-                        pixels[2] = pixels[3];
-                        pixels[3] = temp;
-
-                        temp = pixels[7];
-                        pixels[7] = pixels[6];
-                        pixels[6] = pixels[5];
-                        pixels[5] = pixels[4];
-                        pixels[4] = temp;
-
-                    } else if (strcmp(option, "left") == 0) {
-                        shift = 1;
-
-                    } else if (strcmp(option, "right") == 0) {
-                        shift = -1;
-                    }
-
-                    if (flags.left_to_right) shift *= -1;
-
-                    if (shift == -1) {
-                        Pixel temp = pixels[0];
-                        for (k = 0; k < NUM_PIXELS - 1; k++) {
-                            pixels[k] = pixels[k + 1];
-                        }
-                        pixels[7] = temp;
-
-                    } else if (shift == 1) {
-                        Pixel temp = pixels[7];
-                        for (k = NUM_PIXELS - 2; k >= 0 ; k--) {
-                            pixels[k + 1] = pixels[k];
-                        }
-                        pixels[0] = temp;
-                    }
-                }
-            }
-
-        } else if (strcmp(argv[next_arg], "state") == 0) {
-            // print current state
-            printf("Numbering: %s\n", flags.left_to_right ? "left to right" : "right to left");
-            printf("LEDs: %s\n", flags.leds_on ? "on" : "off");
-            printf("Holding: %s\n", flags.holding ? "on" : "off");
-            printf("Binary: %s\n", flags.binary_on ? "on" : "off");
-            printf("Binary mask: %d\n", flags.binary_mask);
-            printf("\n");
-            printf("# brightness red green blue\n");
-            for (k = 0; k < NUM_PIXELS; k++) {
-                printf("%d      %2d    %3d  %3d  %3d\n",
-                       k,
-                       pixels[k].brightness,
-                       pixels[k].red,
-                       pixels[k].green,
-                       pixels[k].blue);
-            }
-
-        } else if (strcmp(argv[next_arg], "version") == 0) {
-            version();
-
-        } else if (strcmp(argv[next_arg], "help") == 0) {
-            usage();
-
-        } else if (strcmp(argv[next_arg], "man-page") == 0) {
-            man_page_source();
-
-        } else if (strcmp(argv[next_arg], "license") == 0) {
-            license();
+        if (mode != NULL && mode->needs_gpio && daemon_running()) {
+            fprintf(stderr, "blinktd is running; stop it to use blinkt %s\n", mode->name);
+            return 1;
+        }
 
-        } else {
-            // set RGB by named color
-            const char *color = argv[next_arg];
-            bool use_named_color = false;
-            Color colors[] = {
-                {"red",       255,      0,      0},
-                {"coral",     255,      8,      0},
-                {"orange",    255,     20,      0},
-                {"gold",      255,     60,      0},
-                {"yellow",    255,     88,      0},
-                {"lime",      160,    255,      0},
-                {"green",       0,    255,      0},
-                {"aqua",        0,     80,     24},
-                {"blue",        0,      0,    255},
-                {"purple",     72,      0,    120},
-                {"pink",      220,      0,     40},
-                {"white",     255,    255,    255},
-                {"black",       0,      0,      0},
-            };
+        if (mode != NULL) return mode->run(argc, argv);
+    }
 
-            int num_colors = sizeof(colors) / sizeof(Color);
-            int red = 0;
-            int green = 0;
-            int blue = 0;
+    // let blinktd run command if it is running
+    if (argc > 1 && send_to_daemon(argc, argv)) {
+        mark_phase(PHASE_COMMAND);
+        return 0;
+    }
 
-            for (k = 0; k < num_colors && !use_named_color; k++) {
-                use_named_color = strcmp(color, colors[k].name) == 0;
-                red = colors[k].red;
-                green = colors[k].green;
-                blue = colors[k].blue;
-            }
+    // delay needs neither state nor GPIO
+    delay = command_delay(argc, argv);
+    if (delay >= 0) {
+        sleep_msec(delay);
+        return 0;
+    }
 
-            if (use_named_color) {
-                for (k = 0; k < NUM_PIXELS; k++) {
-                    if ((select_mask & (1 << k)) != 0) {
-                        pixels[k].red = red;
-                        pixels[k].green = green;
-                        pixels[k].blue = blue;
-                    }
-                }
+    // read chain length and pins; OK if does not exist
+    read_profile(profile_path != NULL ? profile_path : PROFILE_PATH);
+    if (profile.stats) timing_on = true;
 
-            } else {
-                fprintf(stderr, "Unknown option\n");
-            }
+    // each group between delays is an update of its own, so no delay is waited out while the
+    // state is locked; the argument before a group stands in for its program name
+    for (first = 1; first <= argc; first = end + 2) {
+        end = command_group_end(argc, argv, first);
+        if (end > first || argc == 1) {
+            if (apply_command(end - first + 1, argv + first - 1)) changed = true;
         }
 
-    } else {
-        // if no options, print help
-        usage();
+        if (end + 1 < argc) sleep_msec(atoi(argv[end + 1]));
     }
 
-    if (!states_are_same(&previous_flags, previous_pixels, &flags, pixels)) {
-        if (!flags.holding) {
-            write_to_blinkt(flags, pixels);
-        }
-
-        write_state_file(FILE_PATH, flags, pixels);
-    }
-    
     close_gpio();
+    mark_phase(PHASE_GPIO_CLOSE);
+    if (profile.stats) record_invocation(changed);
 
     return 0;
 }
@@ -0,0 +1,314 @@
+//
+// meter.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// System meter. The /proc file for the metric is opened once and re-read with pread each
+// interval, parsed in place without stdio, and turned into a percentage: CPU busy time, 1-minute
+// load per CPU, memory in use, or the busiest disk's time doing I/O. The percentage is shown as
+// a bar from the left end of the board or as a binary number, green, yellow above the warning
+// threshold and red above the alert threshold. A frame is sent only when the display changes.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blinkt.h"
+#include "meter.h"
+#include "mode.h"
+#include "timing.h"
+
+#define PROC_BUFFER_SIZE 16384
+
+typedef enum { METER_CPU, METER_LOAD, METER_MEM, METER_DISK } Metric;
+
+typedef struct {
+    Metric metric;
+    const char *name;
+    const char *path;
+} MeterInfo;
+
+static const MeterInfo meters[] = {
+    { METER_CPU, "cpu", "/proc/stat" },
+    { METER_LOAD, "load", "/proc/loadavg" },
+    { METER_MEM, "mem", "/proc/meminfo" },
+    { METER_DISK, "disk", "/proc/diskstats" },
+};
+
+// same as named colors
+static const Pixel green = { .red = 0, .green = 255, .blue = 0 };
+static const Pixel yellow = { .red = 255, .green = 88, .blue = 0 };
+static const Pixel red = { .red = 255, .green = 0, .blue = 0 };
+
+static char proc_buffer[PROC_BUFFER_SIZE];
+
+// read whole file from start into proc_buffer; false on error
+static bool read_proc(int fd)
+{
+    ssize_t count = pread(fd, proc_buffer, sizeof(proc_buffer) - 1, 0);
+
+    if (count < 0) return false;
+    proc_buffer[count] = '\0';
+    return true;
+}
+
+// parse unsigned decimal at *p, skipping leading spaces; advance *p past it
+static uint64_t next_number(const char **p)
+{
+    uint64_t n = 0;
+
+    while (**p == ' ') (*p)++;
+    while (**p >= '0' && **p <= '9') n = n * 10 + *(*p)++ - '0';
+    return n;
+}
+
+// skip to start of next line; false at end of buffer
+static bool next_line(const char **p)
+{
+    const char *end = strchr(*p, '\n');
+
+    if (end == NULL || end[1] == '\0') return false;
+    *p = end + 1;
+    return true;
+}
+
+// busy and total jiffies from first line of /proc/stat
+static void cpu_sample(uint64_t *busy, uint64_t *total)
+{
+    const char *p = proc_buffer + 3;    // "cpu"
+    uint64_t idle = 0;
+    int k;
+
+    *total = 0;
+    for (k = 0; k < 8; k++) {
+        uint64_t n = next_number(&p);
+
+        *total += n;
+        if (k == 3 || k == 4) idle += n;    // idle, iowait
+    }
+
+    *busy = *total - idle;
+}
+
+// io_ticks (msec spent doing I/O) of each device in /proc/diskstats into ticks[]; return number
+// of devices
+static int disk_sample(uint64_t ticks[], int max_devices)
+{
+    const char *p = proc_buffer;
+    int count = 0;
+
+    do {
+        int k;
+
+        next_number(&p);    // major
+        next_number(&p);    // minor
+        while (*p == ' ') p++;
+
+        // loop and ram devices are not real I/O
+        if (strncmp(p, "loop", 4) != 0 && strncmp(p, "ram", 3) != 0 && strncmp(p, "zram", 4) != 0) {
+            while (*p != ' ' && *p != '\0') p++;
+            for (k = 0; k < 9; k++) next_number(&p);
+            if (count < max_devices) ticks[count++] = next_number(&p);
+        }
+    } while (next_line(&p));
+
+    return count;
+}
+
+// value of "name:" line in /proc/meminfo, in kB
+static uint64_t meminfo_value(const char *name)
+{
+    const char *p = strstr(proc_buffer, name);
+
+    if (p == NULL) return 0;
+    p += strlen(name);
+    return next_number(&p);
+}
+
+// 1-minute load average from /proc/loadavg, times 100
+static uint64_t load_sample(void)
+{
+    const char *p = proc_buffer;
+    uint64_t load = next_number(&p) * 100;
+
+    if (*p == '.') {
+        p++;
+        if (*p >= '0' && *p <= '9') load += (*p++ - '0') * 10;
+        if (*p >= '0' && *p <= '9') load += *p - '0';
+    }
+
+    return load;
+}
+
+int run_meter(int argc, const char *argv[])
+{
+    const MeterInfo *meter = NULL;
+    int interval = 1000;
+    int warn = 70;
+    int alert = 90;
+    bool binary = false;
+    bool valid = argc > 2;
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t last_busy = 0, last_total = 0;
+    uint64_t last_ticks[64], ticks[64];
+    int devices = 0;
+    int last_display = -1;
+    Pixel *pixels;
+    Flags flags;
+    int64_t deadline;
+    int64_t last_time;
+    int fd;
+    int k;
+
+    for (k = 0; valid && k < (int)(sizeof(meters) / sizeof(meters[0])); k++) {
+        if (strcmp(argv[2], meters[k].name) == 0) meter = &meters[k];
+    }
+
+    for (k = 3; valid && k < argc; k++) {
+        if (strcmp(argv[k], "--interval") == 0 && k + 1 < argc) {
+            interval = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--warn") == 0 && k + 1 < argc) {
+            warn = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--alert") == 0 && k + 1 < argc) {
+            alert = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--binary") == 0) {
+            binary = true;
+
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid || meter == NULL || interval < 10 || interval > 3600000 ||
+        warn < 0 || warn > 100 || alert < warn || alert > 100) {
+        fprintf(stderr, "Usage: blinkt meter (cpu | load | mem | disk) [--interval <msec>] "
+                "[--warn <0-100>] [--alert <0-100>] [--binary]\n");
+        return 1;
+    }
+
+    fd = open(meter->path, O_RDONLY);
+    if (fd < 0 || !read_proc(fd)) {
+        perror(meter->path);
+        return 1;
+    }
+
+    if (cpus < 1) cpus = 1;
+    if (meter->metric == METER_CPU) cpu_sample(&last_busy, &last_total);
+    if (meter->metric == METER_DISK) devices = disk_sample(last_ticks, 64);
+
+    pixels = begin_mode(&flags);
+
+    last_time = now_ns();
+    deadline = last_time;
+
+    while (!stop_requested) {
+        int64_t now;
+        int percent = 0;
+        int display;
+        Pixel color;
+
+        // CPU and disk are rates, so wait one interval before first reading
+        if (meter->metric == METER_CPU || meter->metric == METER_DISK || last_display >= 0) {
+            deadline += (int64_t)interval * 1000000;
+            if (!sleep_until(deadline)) break;
+        }
+
+        if (!read_proc(fd)) break;
+        now = now_ns();
+
+        switch (meter->metric) {
+            case METER_CPU: {
+                uint64_t busy, total;
+
+                cpu_sample(&busy, &total);
+                if (total > last_total) percent = (int)((busy - last_busy) * 100 / (total - last_total));
+                last_busy = busy;
+                last_total = total;
+                break;
+            }
+
+            case METER_LOAD:
+                percent = (int)(load_sample() / cpus);
+                break;
+
+            case METER_MEM: {
+                uint64_t total = meminfo_value("MemTotal:");
+
+                if (total > 0) percent = (int)((total - meminfo_value("MemAvailable:")) * 100 / total);
+                break;
+            }
+
+            case METER_DISK: {
+                int count = disk_sample(ticks, 64);
+                int64_t elapsed_ms = (now - last_time) / 1000000;
+
+                for (k = 0; k < count && k < devices; k++) {
+                    int busy = elapsed_ms > 0 ? (int)((ticks[k] - last_ticks[k]) * 100 / elapsed_ms) : 0;
+
+                    if (busy > percent) percent = busy;
+                }
+
+                memcpy(last_ticks, ticks, sizeof(ticks));
+                devices = count;
+                break;
+            }
+        }
+
+        last_time = now;
+        if (percent > 100) percent = 100;
+        if (percent < 0) percent = 0;
+
+        // pixels lit for bar, or number shown for binary, plus color level
+        color = percent >= alert ? red : percent >= warn ? yellow : green;
+        display = binary ? percent : (percent * profile.num_pixels + 50) / 100;
+        display = display * 3 + (percent >= alert ? 2 : percent >= warn ? 1 : 0);
+        if (display == last_display) continue;
+        last_display = display;
+
+        flags.binary_on = binary;
+        if (binary) flags.binary_mask = flags.left_to_right ? swap_bits(percent) : percent;
+
+        for (k = 0; k < profile.num_pixels; k++) {
+            int position = flags.left_to_right ? k : profile.num_pixels - 1 - k;
+            bool lit = binary || position < display / 3;
+
+            pixels[k].red = lit ? color.red : 0;
+            pixels[k].green = lit ? color.green : 0;
+            pixels[k].blue = lit ? color.blue : 0;
+        }
+
+        show_frame(flags, pixels);
+    }
+
+    close(fd);
+    end_mode(flags, pixels, true);
+
+    return 0;
+}
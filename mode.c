@@ -0,0 +1,111 @@
+//
+// mode.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// setup and teardown shared by the modes that run their own frame loop
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "frame.h"
+#include "mode.h"
+#include "timing.h"
+
+// state as the mode found it, so that only what the mode changed is written back
+static Flags begin_flags;
+static Pixel *begin_pixels = NULL;
+
+Pixel *begin_mode(Flags *flags)
+{
+    const char *profile_path = getenv("BLINKT_PROFILE");
+    Pixel *pixels;
+
+    read_profile(profile_path != NULL ? profile_path : PROFILE_PATH);
+    pixels = alloc_pixels();
+    begin_pixels = alloc_pixels();
+    init_state(flags, pixels);
+
+    // opening state file for update lets the bus lock be taken for each frame
+    begin_state_update(FILE_PATH);
+    read_state_file(FILE_PATH, flags, pixels);
+    end_state_update();
+    copy_state(flags, pixels, &begin_flags, begin_pixels);
+
+    catch_stop();
+
+    return pixels;
+}
+
+void send_mode_frame(void)
+{
+    bool locked = lock_bus();
+
+    send_frame();
+    if (locked) unlock_bus();
+}
+
+void show_frame(Flags flags, Pixel pixels[])
+{
+    build_frame(flags, pixels, get_frame_buffer());
+    send_mode_frame();
+}
+
+// take whatever mode changed from what it found into state as it is now
+static void merge_state(Flags flags, const Pixel pixels[], Flags *state, Pixel state_pixels[])
+{
+    int k;
+
+    if (flags.left_to_right != begin_flags.left_to_right) state->left_to_right = flags.left_to_right;
+    if (flags.leds_on != begin_flags.leds_on) state->leds_on = flags.leds_on;
+    if (flags.holding != begin_flags.holding) state->holding = flags.holding;
+    if (flags.binary_on != begin_flags.binary_on) state->binary_on = flags.binary_on;
+    if (flags.binary_mask != begin_flags.binary_mask) state->binary_mask = flags.binary_mask;
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        if (memcmp(&pixels[k], &begin_pixels[k], sizeof(Pixel)) != 0) state_pixels[k] = pixels[k];
+    }
+}
+
+void end_mode(Flags flags, Pixel pixels[], bool shown)
+{
+    if (shown) {
+        Pixel *state_pixels = alloc_pixels();
+        Flags state_flags;
+
+        // commands run while mode was running keep whatever the mode did not change
+        init_state(&state_flags, state_pixels);
+        begin_state_update(FILE_PATH);
+        read_state_file(FILE_PATH, &state_flags, state_pixels);
+        merge_state(flags, pixels, &state_flags, state_pixels);
+        write_state_file(FILE_PATH, state_flags, state_pixels);
+        end_state_update();
+        free(state_pixels);
+    }
+
+    close_gpio();
+    free(pixels);
+    free(begin_pixels);
+    begin_pixels = NULL;
+}
@@ -0,0 +1,46 @@
+//
+// mode.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef mode_h
+#define mode_h
+
+#include "blinkt.h"
+
+// start a mode that drives the LEDs itself, such as play or stream: read profile and state file,
+// and catch SIGINT and SIGTERM in stop_requested. Returns pixels as saved, for mode to change.
+Pixel *begin_mode(Flags *flags);
+
+// send frame built in frame buffer, waiting for bus lock so frames from blinkt commands run
+// meanwhile are not sent at the same time
+void send_mode_frame(void);
+
+// build frame for flags and pixels, then send it as send_mode_frame() does
+void show_frame(Flags flags, Pixel pixels[]);
+
+// if mode showed anything, leave what it changed in state file, so later commands start from what
+// it showed last; then release GPIO and free pixels
+void end_mode(Flags flags, Pixel pixels[], bool shown);
+
+#endif /* mode_h */
@@ -0,0 +1,262 @@
+//
+// opc.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Open Pixel Control server. Each message is a channel byte, a command byte, a 16-bit big-endian
+// length and that many data bytes; command 0 sets pixel colors from red, green, blue triples.
+// Messages for channel 0 (broadcast) or our channel are parsed where they were received, in each
+// client's buffer, and written into the pixel array. All clients share one epoll loop; a frame is
+// sent once per pass through the loop, so when messages arrive faster than the LEDs can take
+// them, only the newest colors are sent.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "mode.h"
+#include "opc.h"
+#include "timing.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define OPC_HEADER 4
+#define OPC_SET_PIXELS 0
+#define OPC_MAX_MESSAGE (OPC_HEADER + 0xFFFF)
+
+#define MAX_EVENTS 16
+
+typedef struct {
+    int fd;
+    size_t length;                      // bytes received and not yet parsed
+    uint8_t buffer[OPC_MAX_MESSAGE];
+} Client;
+
+static int open_listener(int port)
+{
+    struct sockaddr_in address;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        perror("opc");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// copy colors from message data into pixels, numbering from left end of board
+static void set_pixels(Flags flags, const uint8_t *data, int length, Pixel pixels[])
+{
+    int count = length / 3;
+    int p;
+
+    if (count > profile.num_pixels) count = profile.num_pixels;
+
+    for (p = 0; p < count; p++, data += 3) {
+        int k = flags.left_to_right ? p : profile.num_pixels - 1 - p;
+
+        pixels[k].red = data[0];
+        pixels[k].green = data[1];
+        pixels[k].blue = data[2];
+    }
+}
+
+// parse complete messages in client buffer; return number of set-pixel messages applied
+static long parse_messages(Client *client, int channel, Flags flags, Pixel pixels[])
+{
+    const uint8_t *p = client->buffer;
+    const uint8_t *end = client->buffer + client->length;
+    long applied = 0;
+
+    while (end - p >= OPC_HEADER) {
+        int length = (p[2] << 8) | p[3];
+
+        if (end - p < OPC_HEADER + length) break;
+
+        if ((p[0] == 0 || p[0] == channel) && p[1] == OPC_SET_PIXELS) {
+            set_pixels(flags, p + OPC_HEADER, length, pixels);
+            applied++;
+        }
+
+        p += OPC_HEADER + length;
+    }
+
+    // keep partial message for next read
+    client->length = end - p;
+    if (p != client->buffer && client->length > 0) memmove(client->buffer, p, client->length);
+
+    return applied;
+}
+
+int run_opc_server(int argc, const char *argv[])
+{
+    int port = OPC_PORT;
+    int channel = 1;
+    int listen_fd;
+    int epoll_fd;
+    struct epoll_event event;
+    struct epoll_event events[MAX_EVENTS];
+    Pixel *pixels;
+    Flags flags;
+    bool dirty = false;
+    long messages = 0;
+    long frames = 0;
+    int64_t start;
+    int64_t elapsed;
+    int k;
+
+    for (k = 2; k < argc; k++) {
+        if (strcmp(argv[k], "--port") == 0 && k + 1 < argc) {
+            port = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--channel") == 0 && k + 1 < argc) {
+            channel = atoi(argv[++k]);
+
+        } else {
+            port = -1;
+        }
+    }
+
+    if (port < 1 || port > 65535 || channel < 1 || channel > 255) {
+        fprintf(stderr, "Usage: blinkt opc [--port 1-65535] [--channel 1-255]\n");
+        return 1;
+    }
+
+    pixels = begin_mode(&flags);
+
+    listen_fd = open_listener(port);
+    if (listen_fd < 0) {
+        free(pixels);
+        return 1;
+    }
+
+    epoll_fd = epoll_create1(0);
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;      // NULL marks listening socket
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Listening for OPC on port %d, channel %d\n", port, channel);
+    start = now_ns();
+
+    while (!stop_requested) {
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+
+        for (k = 0; k < ready; k++) {
+            Client *client = events[k].data.ptr;
+
+            if (client == NULL) {
+                int fd = accept(listen_fd, NULL, NULL);
+
+                if (fd < 0) continue;
+
+                client = malloc(sizeof(Client));
+                if (client == NULL) {
+                    close(fd);
+                    continue;
+                }
+
+                client->fd = fd;
+                client->length = 0;
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                event.events = EPOLLIN;
+                event.data.ptr = client;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+            } else {
+                ssize_t count = read(client->fd, client->buffer + client->length,
+                                     OPC_MAX_MESSAGE - client->length);
+
+                if (count > 0) {
+                    long applied;
+
+                    client->length += count;
+                    applied = parse_messages(client, channel, flags, pixels);
+                    messages += applied;
+                    if (applied > 0) dirty = true;
+
+                } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    // closing removes it from epoll set
+                    close(client->fd);
+                    free(client);
+                }
+            }
+        }
+
+        // one frame for everything received in this pass
+        if (dirty) {
+            show_frame(flags, pixels);
+            frames++;
+            dirty = false;
+        }
+    }
+
+    elapsed = now_ns() - start;
+
+    close(epoll_fd);
+    close(listen_fd);
+    end_mode(flags, pixels, true);
+
+    fprintf(stderr, "%ld messages, %ld frames in %.3f s, %.1f fps\n",
+            messages, frames, elapsed / 1e9, elapsed > 0 ? frames * 1e9 / elapsed : 0.0);
+
+    return 0;
+}
+
+#else
+
+int run_opc_server(int argc, const char *argv[])
+{
+    fprintf(stderr, "OPC server needs Linux\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,298 @@
+//
+// pigpio_backend.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// pigpio output, either through the pigpiod daemon or by linking the library directly (needs root).
+// see http://abyz.me.uk/rpi/pigpio/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+
+#ifdef HAVE_PIGPIO
+
+#include <pigpiod_if2.h>
+
+// pins not connected to the Blinkt!, claimed only by bit-banged SPI output
+#define SPI_CS 25
+#define SPI_MISO 22
+
+// bit-banged SPI clock rate; pigpio allows at most 250 kHz
+#define SPI_BAUD 250000
+
+// waveform timing, microseconds per clock half-period
+#define WAVE_US 1
+
+// most pulses pigpio accepts in one waveform; longer chains are sent edge by edge
+#define WAVE_PULSE_LIMIT 12000
+
+int pi = -1;
+bool daemon = false;
+static bool wave_ok = true;  // false if daemon could not build waveforms; use per-edge writes
+static bool spi_on = false;  // true if frames go out in one bit-banged SPI transfer
+
+static gpioPulse_t *pulses = NULL;  // waveform buffer, allocated on first use
+static char *spi_tx = NULL;         // bit-banged SPI buffers, allocated when opened
+static char *spi_rx = NULL;
+
+// set up pins and optional output mode
+static void setup_pins(void)
+{
+    const char *output = getenv("BLINKT_OUTPUT");
+
+    if (daemon) {
+        set_mode(pi, profile.dat, PI_OUTPUT);
+        set_mode(pi, profile.clk, PI_OUTPUT);
+        gpio_write(pi, profile.dat, 0);
+        gpio_write(pi, profile.clk, 0);
+
+    } else {
+        gpioSetMode(profile.dat, PI_OUTPUT);
+        gpioSetMode(profile.clk, PI_OUTPUT);
+        gpioWrite(profile.dat, 0);
+        gpioWrite(profile.clk, 0);
+    }
+
+    // BLINKT_OUTPUT=bbspi sends each frame as one bit-banged SPI transfer
+    if (output != NULL && strcmp(output, "bbspi") == 0) {
+        int result;
+        if (daemon) {
+            result = bb_spi_open(pi, SPI_CS, SPI_MISO, profile.dat, profile.clk, SPI_BAUD, 0);
+
+        } else {
+            result = bbSPIOpen(SPI_CS, SPI_MISO, profile.dat, profile.clk, SPI_BAUD, 0);
+        }
+
+        spi_on = result >= 0;
+        if (spi_on) {
+            spi_tx = malloc(frame_bytes());
+            spi_rx = malloc(frame_bytes());
+            spi_on = spi_tx != NULL && spi_rx != NULL;
+        }
+
+        if (!spi_on) fprintf(stderr, "Unable to open bit-banged SPI; sending each edge\n");
+
+    } else if (output != NULL && strcmp(output, "edges") == 0) {
+        wave_ok = false;
+    }
+}
+
+static bool pigpiod_init(void)
+{
+    pi = pigpio_start(NULL, NULL);
+    if (pi < 0) return false;
+
+    daemon = true;
+    setup_pins();
+
+    return true;
+}
+
+static bool pigpio_init(void)
+{
+    if (gpioInitialise() < 0) return false;
+
+    daemon = false;
+    setup_pins();
+
+    return true;
+}
+
+// write one GPIO pin through daemon or library
+static void write_pin(unsigned gpio, unsigned level)
+{
+    if (daemon) {
+        gpio_write(pi, gpio, level);
+
+    } else {
+        gpioWrite(gpio, level);
+    }
+
+    frame_round_trips++;
+}
+
+static void pigpio_write_edges(const Edge *edges, int count)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        if (edges[i] != EDGE_CLK) write_pin(profile.dat, edges[i] == EDGE_DAT1_CLK);
+
+        write_pin(profile.clk, 1);
+        write_pin(profile.clk, 0);
+    }
+}
+
+// append pulses for one data bit: set data with clock low, then raise clock
+static int add_wave_bit(gpioPulse_t *wave, int n, bool bit)
+{
+    wave[n].gpioOn = bit ? (1 << profile.dat) : 0;
+    wave[n].gpioOff = (1 << profile.clk) | (bit ? 0 : (1 << profile.dat));
+    wave[n].usDelay = WAVE_US;
+    n++;
+
+    wave[n].gpioOn = 1 << profile.clk;
+    wave[n].gpioOff = 0;
+    wave[n].usDelay = WAVE_US;
+    n++;
+
+    return n;
+}
+
+// send whole frame to pigpiod as a single waveform; return false if daemon refuses it
+static bool write_wave(const uint8_t *frame, int length)
+{
+    int n = 0;
+    int wave_id;
+    bool sent;
+    int i, k;
+
+    // two pulses for every bit, plus final clock low
+    if (2 * 8 * length + 1 > WAVE_PULSE_LIMIT) return false;
+
+    if (pulses == NULL) pulses = malloc(WAVE_PULSE_LIMIT * sizeof(gpioPulse_t));
+    if (pulses == NULL) return false;
+
+    for (k = 0; k < length; k++) {
+        for (i = 7; i >= 0; i--) {
+            n = add_wave_bit(pulses, n, (frame[k] & (1 << i)) != 0);
+        }
+    }
+
+    // leave clock low
+    pulses[n].gpioOn = 0;
+    pulses[n].gpioOff = 1 << profile.clk;
+    pulses[n].usDelay = WAVE_US;
+    n++;
+
+    frame_round_trips += 3;
+    if (wave_add_new(pi) < 0 || wave_add_generic(pi, n, pulses) < 0) return false;
+
+    wave_id = wave_create(pi);
+    if (wave_id < 0) return false;
+
+    frame_round_trips++;
+    sent = wave_send_once(pi, wave_id) >= 0;
+    if (sent) {
+        // wait for most of the waveform before asking whether it is done
+        sleep_msec((n * WAVE_US) / 1000);
+
+        frame_round_trips++;
+        while (wave_tx_busy(pi) == 1) {
+            sleep_msec(1);
+            frame_round_trips++;
+        }
+    }
+
+    frame_round_trips++;
+    wave_delete(pi, wave_id);
+
+    // if not sent, caller sends frame edge by edge instead
+    return sent;
+}
+
+// send whole frame in one bit-banged SPI transfer
+static bool write_spi(const uint8_t *frame, int length)
+{
+    int result;
+
+    memcpy(spi_tx, frame, length);
+
+    frame_round_trips++;
+    if (daemon) {
+        result = bb_spi_xfer(pi, SPI_CS, spi_tx, spi_rx, length);
+
+    } else {
+        result = bbSPIXfer(SPI_CS, spi_tx, spi_rx, length);
+    }
+
+    return result == length;
+}
+
+static bool pigpio_write_frame(const uint8_t *frame, int length)
+{
+    if (spi_on) {
+        spi_on = write_spi(frame, length);
+        if (spi_on) return true;
+
+        fprintf(stderr, "Bit-banged SPI transfer failed; sending each edge\n");
+
+    } else if (daemon && wave_ok) {
+        wave_ok = write_wave(frame, length);
+        if (wave_ok) return true;
+    }
+
+    // fall back to sending each edge
+    frame_round_trips = 0;
+
+    return false;
+}
+
+static void pigpio_flush(void)
+{
+}
+
+static void pigpio_close(void)
+{
+    if (spi_on) {
+        if (daemon) {
+            bb_spi_close(pi, SPI_CS);
+
+        } else {
+            bbSPIClose(SPI_CS);
+        }
+    }
+
+    if (daemon) {
+        pigpio_stop(pi);
+
+    } else {
+        gpioTerminate();
+    }
+
+    free(pulses);
+    free(spi_tx);
+    free(spi_rx);
+    pulses = NULL;
+    spi_tx = NULL;
+    spi_rx = NULL;
+}
+
+static void pigpio_report(FILE *out)
+{
+    fprintf(out, "%s per frame: %d\n", daemon ? "pigpiod round trips" : "pigpio library calls",
+            frame_round_trips);
+}
+
+const Backend pigpiod_backend = {
+    "pigpiod", pigpiod_init, pigpio_write_edges, pigpio_write_frame, pigpio_flush, pigpio_close,
+    pigpio_report
+};
+
+const Backend pigpio_backend = {
+    "pigpio", pigpio_init, pigpio_write_edges, pigpio_write_frame, pigpio_flush, pigpio_close,
+    pigpio_report
+};
+
+#endif
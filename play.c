@@ -0,0 +1,221 @@
+//
+// play.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// play an animation file. The file is mapped, not read: full frames are handed to the backend
+// straight from the mapping, and delta frames are applied to one frame buffer, so memory use
+// does not grow with the file, and pages already played are given back.
+
+#define _DEFAULT_SOURCE     // madvise()
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mode.h"
+#include "play.h"
+#include "timing.h"
+
+// frames between giving back pages already played
+#define RELEASE_FRAMES 256
+
+// map animation and check header; NULL with message if not usable
+static const AnimationHeader *map_animation(const char *path, size_t *size)
+{
+    const AnimationHeader *header;
+    struct stat statbuf;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &statbuf) != 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    *size = statbuf.st_size;
+    header = *size >= sizeof(AnimationHeader) ?
+             mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (header == MAP_FAILED ||
+        memcmp(header->magic, ANIMATION_MAGIC, 4) != 0 || header->version != ANIMATION_VERSION) {
+        fprintf(stderr, "%s is not an animation file\n", path);
+        if (header != MAP_FAILED) munmap((void *)header, *size);
+        return NULL;
+    }
+
+    if (header->num_pixels != (uint32_t)profile.num_pixels ||
+        header->fps < 1 || header->fps > MAX_ANIMATION_FPS ||
+        ((header->flags & ANIMATION_DELTA) == 0 &&
+         (*size - sizeof(AnimationHeader)) / (header->num_pixels * sizeof(Pixel)) < header->num_frames)) {
+        fprintf(stderr, "%s was made for %u pixels at %u fps with %u frames; does not fit\n",
+                path, header->num_pixels, header->fps, header->num_frames);
+        munmap((void *)header, *size);
+        return NULL;
+    }
+
+    madvise((void *)header, *size, MADV_SEQUENTIAL);
+    return header;
+}
+
+int play_animation(int argc, const char *argv[])
+{
+    const char *path = NULL;
+    const AnimationHeader *header;
+    const uint8_t *start_of_frames;
+    const uint8_t *end_of_file;
+    bool loop = false;
+    bool delta;
+    size_t size;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    Pixel *frame_pixels = NULL;
+    Pixel *pixels = NULL;   // frame most recently shown
+    Pixel *state_pixels;
+    Flags flags;
+    long frames = 0;
+    long dropped = 0;
+    int64_t period;
+    int64_t start;
+    int64_t elapsed;
+    long tick = 0;
+    int k;
+
+    for (k = 2; k < argc; k++) {
+        if (strcmp(argv[k], "--loop") == 0) {
+            loop = true;
+
+        } else {
+            path = argv[k];
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "Usage: blinkt play <file> [--loop]\n");
+        return 1;
+    }
+
+    state_pixels = begin_mode(&flags);
+
+    header = map_animation(path, &size);
+    if (header == NULL) {
+        free(state_pixels);
+        return 1;
+    }
+
+    delta = (header->flags & ANIMATION_DELTA) != 0;
+    start_of_frames = (const uint8_t *)(header + 1);
+    end_of_file = (const uint8_t *)header + size;
+    if (delta) frame_pixels = alloc_pixels();
+
+    // frames are shown as recorded, so use them with LEDs on and not in binary mode
+    flags.leds_on = true;
+    flags.holding = false;
+    flags.binary_on = false;
+
+    period = 1000000000 / header->fps;
+    start = now_ns();
+
+    do {
+        const uint8_t *p = start_of_frames;
+        const uint8_t *released = (const uint8_t *)header;
+        uint32_t n;
+
+        // as when file was written, every pixel starts at 0, brightness included
+        if (delta) memset(frame_pixels, 0, profile.num_pixels * sizeof(Pixel));
+
+        for (n = 0; n < header->num_frames && !stop_requested; n++, tick++) {
+            int64_t deadline = start + tick * period;
+
+            if (delta) {
+                uint32_t count;
+                const AnimationChange *change;
+                uint32_t c;
+
+                if (end_of_file - p < (ptrdiff_t)sizeof(uint32_t)) break;
+                memcpy(&count, p, sizeof(count));
+                change = (const AnimationChange *)(p + sizeof(uint32_t));
+                if ((size_t)(end_of_file - (const uint8_t *)change) / sizeof(AnimationChange) < count) break;
+
+                for (c = 0; c < count; c++) {
+                    if (change[c].index < header->num_pixels) frame_pixels[change[c].index] = change[c].pixel;
+                }
+
+                p = (const uint8_t *)(change + count);
+                pixels = frame_pixels;
+
+            } else {
+                pixels = (Pixel *)p;
+                p += header->num_pixels * sizeof(Pixel);
+            }
+
+            // keep to recorded timing; drop a frame that is already a whole period late
+            if (now_ns() >= deadline + period) {
+                dropped++;
+
+            } else {
+                sleep_until(deadline);
+                show_frame(flags, pixels);
+                frames++;
+            }
+
+            // give back pages already played
+            if (n % RELEASE_FRAMES == RELEASE_FRAMES - 1) {
+                const uint8_t *upto = (const uint8_t *)header +
+                                      ((p - (const uint8_t *)header) / page_size) * page_size;
+
+                if (upto > released) {
+                    madvise((void *)released, upto - released, MADV_DONTNEED);
+                    released = upto;
+                }
+            }
+        }
+
+        if (n < header->num_frames && !stop_requested) {
+            fprintf(stderr, "%s is cut short after frame %u\n", path, n);
+            break;
+        }
+    } while (loop && !stop_requested);
+
+    // last frame stays up for its whole period
+    if (!stop_requested) sleep_until(start + tick * period);
+
+    elapsed = now_ns() - start;
+
+    if (pixels != NULL) memcpy(state_pixels, pixels, profile.num_pixels * sizeof(Pixel));
+    munmap((void *)header, size);
+    end_mode(flags, state_pixels, pixels != NULL);
+    free(frame_pixels);
+
+    fprintf(stdout, "%ld frames in %.3f s, %ld dropped, %.1f fps\n",
+            frames, elapsed / 1e9, dropped, elapsed > 0 ? frames * 1e9 / elapsed : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+//
+// play.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef play_h
+#define play_h
+
+#include <stdint.h>
+
+#include "blinkt.h"
+
+// Animation file, as written by blinkt compile and read by blinkt play. All numbers are in the
+// byte order of the machine that wrote it (little-endian on a Pi). After the header come
+// num_frames frames, each one of:
+//   full frames: num_pixels Pixel records
+//   delta frames (ANIMATION_DELTA set): a uint32_t count, then count AnimationChange records
+//     giving pixels that differ from the frame before; before the first frame all pixels are 0
+#define ANIMATION_MAGIC "BLKA"
+#define ANIMATION_VERSION 1
+#define ANIMATION_DELTA 0x0001
+
+typedef struct {
+    char magic[4];          // ANIMATION_MAGIC
+    uint16_t version;       // ANIMATION_VERSION
+    uint16_t flags;
+    uint32_t num_pixels;
+    uint32_t fps;
+    uint32_t num_frames;
+} AnimationHeader;
+
+typedef struct {
+    uint32_t index;
+    Pixel pixel;
+} AnimationChange;
+
+#define MAX_ANIMATION_FPS 1000
+
+// blinkt play <file> [--loop]
+int play_animation(int argc, const char *argv[]);
+
+#endif /* play_h */
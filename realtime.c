@@ -0,0 +1,131 @@
+//
+// realtime.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Real-time mode for bit-banged output. A frame is thousands of GPIO writes with no hardware
+// buffering, so being preempted or taking a page fault partway through stretches a clock
+// pulse by milliseconds. While a frame is sent, SCHED_FIFO keeps ordinary processes from
+// preempting the writer, and the frame buffers and a stack reserve are locked in memory so they
+// never fault. Priority and CPU go back to what they were once the frame is out, so a long
+// running mode such as blinktd or stream is only real-time while it holds the bus.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "realtime.h"
+
+#ifdef __linux__
+
+#include <sched.h>
+
+#include <sys/mman.h>
+
+// stack touched and locked up front; far more than frame output uses
+#define STACK_RESERVE (64 * 1024)
+
+// scheduling to go back to after each frame
+static bool saved = false;
+static int saved_policy;
+static struct sched_param saved_param;
+static cpu_set_t saved_cpus;
+
+// cleared if not permitted, so a warning is printed once rather than every frame
+static bool use_priority = false;
+static bool use_cpu = false;
+
+static void lock_stack(void)
+{
+    volatile char reserve[STACK_RESERVE];
+
+    memset((char *)reserve, 0, sizeof(reserve));
+    lock_realtime_memory((const void *)reserve, sizeof(reserve));
+}
+
+void lock_realtime_memory(const void *address, size_t length)
+{
+    if (profile.realtime > 0 && mlock(address, length) != 0) perror("realtime: locking memory");
+}
+
+void enter_realtime(void)
+{
+    if (!saved) {
+        saved = true;
+        saved_policy = sched_getscheduler(0);
+        sched_getparam(0, &saved_param);
+        use_cpu = profile.cpu >= 0 && sched_getaffinity(0, sizeof(saved_cpus), &saved_cpus) == 0;
+        use_priority = profile.realtime > 0 && saved_policy >= 0;
+        if (use_priority) lock_stack();
+    }
+
+    if (use_cpu) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(profile.cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            perror("realtime: CPU affinity");
+            use_cpu = false;
+        }
+    }
+
+    if (use_priority) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = profile.realtime;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+            perror("realtime: SCHED_FIFO");
+            use_priority = false;
+        }
+    }
+}
+
+void leave_realtime(void)
+{
+    if (use_priority) sched_setscheduler(0, saved_policy, &saved_param);
+    if (use_cpu) sched_setaffinity(0, sizeof(saved_cpus), &saved_cpus);
+}
+
+#else
+
+void lock_realtime_memory(const void *address, size_t length)
+{
+}
+
+void enter_realtime(void)
+{
+    static bool warned = false;
+
+    if (!warned) fprintf(stderr, "realtime: needs Linux\n");
+    warned = true;
+}
+
+void leave_realtime(void)
+{
+}
+
+#endif
@@ -0,0 +1,444 @@
+//
+// script.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// run many blinkt commands in one process: GPIO is opened once, each command is one locked update
+// of the state file, and delays are measured from when the script started so timing does not
+// drift. A delay inside a line splits it, and is never waited out with the state locked. animate
+// repeats one command on a fixed frame clock in the same way, and compile records a script as an
+// animation file for blinkt play.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blinkt.h"
+#include "blinktd.h"
+#include "command.h"
+#include "effects.h"
+#include "fade.h"
+#include "play.h"
+#include "script.h"
+#include "timing.h"
+#include "update.h"
+
+// buffer size for one line of script
+#define LINE_SIZE 256
+
+#define MAX_ARGS 64
+
+#define MAX_FPS 1000
+#define DEFAULT_FPS 10
+#define DEFAULT_COMPILE_FPS 30
+
+// true once blinktd was found not running, so commands are run in this process
+static bool local = false;
+
+// state for compile, which runs commands without touching the state file
+static Pixel *pixels = NULL;
+static Pixel *previous_pixels = NULL;
+static Flags flags;
+static Flags previous_flags;
+
+// split line into arguments after program name; stop at comment. Return argument count.
+static int split_line(char *line, const char *argv[])
+{
+    int argc = 0;
+    char *word;
+
+    argv[argc++] = "blinkt";
+
+    for (word = strtok(line, " \t\r\n"); word != NULL && argc < MAX_ARGS;
+         word = strtok(NULL, " \t\r\n")) {
+        if (word[0] == '#') break;
+        argv[argc++] = word;
+    }
+
+    return argc;
+}
+
+// send command to blinktd, or run it here as one update of the state file
+static void send_command(int argc, const char *argv[])
+{
+    const char *profile_path = getenv("BLINKT_PROFILE");
+
+    if (!local && send_to_daemon(argc, argv)) return;
+
+    if (!local) {
+        // no daemon; GPIO opens with first frame and stays open for rest of run
+        read_profile(profile_path != NULL ? profile_path : PROFILE_PATH);
+        local = true;
+    }
+
+    apply_command(argc, argv);
+}
+
+// send each group of line between delays as a command of its own, and wait out each delay
+// against deadline, outside any lock
+static void send_line(int argc, const char *argv[], int64_t *deadline)
+{
+    int first, end;
+
+    for (first = 1; first <= argc; first = end + 2) {
+        end = command_group_end(argc, argv, first);
+        if (end > first) send_command(end - first + 1, argv + first - 1);
+
+        if (end + 1 < argc) {
+            *deadline += atoi(argv[end + 1]) * (int64_t)1000000;
+            if (!sleep_until(*deadline)) return;
+        }
+    }
+}
+
+// release GPIO
+static void finish_commands(void)
+{
+    if (local) {
+        close_gpio();
+        local = false;
+    }
+}
+
+int run_script(const char *path)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    int64_t deadline;
+    char line[LINE_SIZE];
+    const char *argv[MAX_ARGS];
+
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    deadline = now_ns();
+
+    while (fgets(line, LINE_SIZE, file) != NULL) {
+        int argc = split_line(line, argv);
+
+        if (argc >= 2) send_line(argc, argv, &deadline);
+    }
+
+    if (file != stdin) fclose(file);
+
+    finish_commands();
+
+    return 0;
+}
+
+int run_animation(int argc, const char *argv[])
+{
+    const char *step[MAX_ARGS];
+    int step_count = 0;
+    int fps = DEFAULT_FPS;
+    long count = 0;         // 0 runs until interrupted
+    long tick;
+    long frames = 0;
+    long dropped = 0;
+    int64_t period;
+    int64_t start;
+    int64_t elapsed;
+    int k;
+
+    // everything after animate except options is the command to repeat
+    step[step_count++] = argv[0];
+    for (k = 2; k < argc && step_count < MAX_ARGS; k++) {
+        if (strcmp(argv[k], "--fps") == 0 && k + 1 < argc) {
+            fps = atoi(argv[++k]);
+
+        } else if (strcmp(argv[k], "--count") == 0 && k + 1 < argc) {
+            count = atol(argv[++k]);
+
+        } else {
+            step[step_count++] = argv[k];
+        }
+    }
+
+    if (step_count < 2 || fps < 1 || fps > MAX_FPS || count < 0) {
+        fprintf(stderr, "Usage: blinkt animate <command> [--fps 1-%d] [--count <frames>]\n", MAX_FPS);
+        return 1;
+    }
+
+    // stop cleanly on Ctrl-C, so state is saved and report printed
+    catch_stop();
+
+    // frame k is due at start + k * period, however long earlier frames took; a frame whose
+    // time has already passed by a whole period is dropped rather than shown late
+    period = 1000000000 / fps;
+    start = now_ns();
+
+    for (tick = 0; (count == 0 || tick < count) && !stop_requested; tick++) {
+        int64_t deadline = start + tick * period;
+
+        if (now_ns() >= deadline + period) {
+            dropped++;
+            continue;
+        }
+
+        if (!sleep_until(deadline)) break;
+
+        send_line(step_count, step, &deadline);
+        frames++;
+    }
+
+    // last frame stays up for its whole period
+    if (!stop_requested) sleep_until(start + tick * period);
+
+    elapsed = now_ns() - start;
+
+    finish_commands();
+
+    fprintf(stdout, "%ld frames in %.3f s, %ld dropped, %.1f fps\n",
+            frames, elapsed / 1e9, dropped, elapsed > 0 ? frames * 1e9 / elapsed : 0.0);
+
+    return 0;
+}
+
+// pixels as they would appear: brightness 0 for LEDs turned off or masked out by binary mode
+static void snapshot(Flags shown_flags, const Pixel shown[], Pixel frame[])
+{
+    int k;
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        frame[k] = shown[k];
+        if (!shown_flags.leds_on ||
+            (shown_flags.binary_on && !pixel_selected(shown_flags.binary_mask, k))) {
+            frame[k].brightness = 0;
+        }
+    }
+}
+
+// number of pixels that differ between two frames
+static int count_changes(const Pixel before[], const Pixel after[])
+{
+    int changes = 0;
+    int k;
+
+    for (k = 0; k < profile.num_pixels; k++) {
+        if (memcmp(&before[k], &after[k], sizeof(Pixel)) != 0) changes++;
+    }
+
+    return changes;
+}
+
+// write frames as full or delta, whichever is smaller
+static bool write_animation(FILE *file, int fps, const Pixel frames[], uint32_t num_frames)
+{
+    int n = profile.num_pixels;
+    Pixel *zero = calloc(n, sizeof(Pixel));
+    size_t full_size = (size_t)num_frames * n * sizeof(Pixel);
+    size_t delta_size = 0;
+    AnimationHeader header;
+    bool ok = zero != NULL;
+    uint32_t f;
+    int k;
+
+    for (f = 0; f < num_frames && ok; f++) {
+        const Pixel *before = f == 0 ? zero : &frames[(size_t)(f - 1) * n];
+        delta_size += sizeof(uint32_t) + count_changes(before, &frames[(size_t)f * n]) * sizeof(AnimationChange);
+    }
+
+    memcpy(header.magic, ANIMATION_MAGIC, 4);
+    header.version = ANIMATION_VERSION;
+    header.flags = delta_size < full_size ? ANIMATION_DELTA : 0;
+    header.num_pixels = n;
+    header.fps = fps;
+    header.num_frames = num_frames;
+    if (ok) ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if (ok && (header.flags & ANIMATION_DELTA) == 0) {
+        ok = fwrite(frames, sizeof(Pixel), (size_t)num_frames * n, file) == (size_t)num_frames * n;
+
+    } else {
+        for (f = 0; f < num_frames && ok; f++) {
+            const Pixel *before = f == 0 ? zero : &frames[(size_t)(f - 1) * n];
+            const Pixel *after = &frames[(size_t)f * n];
+            uint32_t count = count_changes(before, after);
+
+            ok = fwrite(&count, sizeof(count), 1, file) == 1;
+            for (k = 0; k < n && ok; k++) {
+                if (memcmp(&before[k], &after[k], sizeof(Pixel)) != 0) {
+                    AnimationChange change = { k, after[k] };
+                    ok = fwrite(&change, sizeof(change), 1, file) == 1;
+                }
+            }
+        }
+    }
+
+    if (ok) fprintf(stdout, "%u frames at %d fps, %s, %zu bytes\n", num_frames, fps,
+                    header.flags & ANIMATION_DELTA ? "delta" : "full",
+                    sizeof(header) + (header.flags & ANIMATION_DELTA ? delta_size : full_size));
+
+    free(zero);
+    return ok;
+}
+
+// append frames until there are until_frame of them, each a copy of shown, or while a fade runs,
+// its step at that frame's time
+static void add_frames(Pixel **frames, uint32_t *num_frames, uint32_t *capacity, int fps,
+                       uint32_t until_frame, Pixel shown[], Pixel fade_pixels[])
+{
+    while (*num_frames < until_frame) {
+        if (*num_frames == *capacity) {
+            *capacity = *capacity == 0 ? 256 : *capacity * 2;
+            *frames = realloc(*frames, (size_t)*capacity * profile.num_pixels * sizeof(Pixel));
+            if (*frames == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+
+        if (fade_running()) {
+            set_fade_clock((int64_t)*num_frames * 1000 / fps);
+            snapshot(flags, fade_frame(fade_pixels) ? fade_pixels : pixels, shown);
+        }
+
+        memcpy(&(*frames)[(size_t)*num_frames * profile.num_pixels], shown,
+               profile.num_pixels * sizeof(Pixel));
+        (*num_frames)++;
+    }
+}
+
+int compile_script(int argc, const char *argv[])
+{
+    const char *script_path = NULL;
+    const char *output_path = NULL;
+    const char *profile_path = getenv("BLINKT_PROFILE");
+    int fps = DEFAULT_COMPILE_FPS;
+    FILE *file;
+    FILE *output;
+    char line[LINE_SIZE];
+    const char *args[MAX_ARGS];
+    Pixel *shown;
+    Pixel *fade_pixels;
+    Pixel *frames = NULL;
+    uint32_t num_frames = 0;
+    uint32_t capacity = 0;
+    int64_t time_ms = 0;
+    bool ok;
+    int k;
+
+    for (k = 2; k < argc; k++) {
+        if (strcmp(argv[k], "--fps") == 0 && k + 1 < argc) {
+            fps = atoi(argv[++k]);
+
+        } else if (script_path == NULL) {
+            script_path = argv[k];
+
+        } else {
+            output_path = argv[k];
+        }
+    }
+
+    if (output_path == NULL || fps < 1 || fps > MAX_ANIMATION_FPS) {
+        fprintf(stderr, "Usage: blinkt compile <script> <file> [--fps 1-%d]\n", MAX_ANIMATION_FPS);
+        return 1;
+    }
+
+    file = strcmp(script_path, "-") == 0 ? stdin : fopen(script_path, "r");
+    if (file == NULL) {
+        perror(script_path);
+        return 1;
+    }
+
+    // start from cleared LEDs, and send any frames that commands write to simulated LEDs
+    setenv("BLINKT_BACKEND", "sim", 1);
+    read_profile(profile_path != NULL ? profile_path : PROFILE_PATH);
+    pixels = alloc_pixels();
+    previous_pixels = alloc_pixels();
+    fade_pixels = alloc_pixels();
+    shown = alloc_pixels();
+    init_state(&flags, pixels);
+    snapshot(flags, pixels, shown);
+
+    // fades are stepped on the compile clock, one recorded frame at a time
+    defer_fades = true;
+
+    // frame k shows what was last shown at time k / fps
+    while (fgets(line, LINE_SIZE, file) != NULL) {
+        int count = split_line(line, args);
+        int first, end;
+
+        for (first = 1; first <= count; first = end + 2) {
+            end = command_group_end(count, args, first);
+
+            if (end > first) {
+                unsigned long fades = fades_started();
+
+                set_effect_clock(time_ms);
+                set_fade_clock(time_ms);
+                copy_state(&flags, pixels, &previous_flags, previous_pixels);
+                run_command(end - first + 1, args + first - 1, &flags, pixels, stdout, stderr);
+
+                // as with blinktd, newer state ends fade in progress unless command started one
+                if (fades_started() == fades &&
+                    !states_are_same(&previous_flags, previous_pixels, &flags, pixels)) {
+                    stop_fade();
+                }
+
+                if (!flags.holding && !fade_running()) snapshot(flags, pixels, shown);
+            }
+
+            if (end + 1 < count) {
+                time_ms += atoi(args[end + 1]);
+                add_frames(&frames, &num_frames, &capacity, fps, (time_ms * fps + 999) / 1000,
+                           shown, fade_pixels);
+            }
+        }
+    }
+
+    if (file != stdin) fclose(file);
+
+    // fade still running at end of script plays out
+    while (fade_running()) {
+        add_frames(&frames, &num_frames, &capacity, fps, num_frames + 1, shown, fade_pixels);
+    }
+
+    // last frame shows final state
+    frames = realloc(frames, (size_t)(num_frames + 1) * profile.num_pixels * sizeof(Pixel));
+    if (frames == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(&frames[(size_t)num_frames * profile.num_pixels], shown, profile.num_pixels * sizeof(Pixel));
+    num_frames++;
+
+    output = fopen(output_path, "wb");
+    ok = output != NULL && write_animation(output, fps, frames, num_frames);
+    if (output != NULL && fclose(output) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Unable to write to %s\n", output_path);
+
+    close_gpio();
+    free(frames);
+    free(shown);
+    free(fade_pixels);
+    free(previous_pixels);
+    free(pixels);
+    pixels = NULL;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+//
+// sim.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// in-memory APA102 chain. Decodes the clock and data stream the way the LEDs do, so frame
+// output can be checked and measured without hardware.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+#include "sim.h"
+
+SimCounts sim_counts;
+Pixel *sim_pixels = NULL;
+static int sim_num_pixels = 0;
+
+static bool sim_data = false;   // level of simulated data pin
+static int zero_bits = 0;       // consecutive zero bits seen; 32 or more is a start frame
+static int word_bits = -1;      // bits of current word received, or -1 if waiting for start frame
+static uint32_t word = 0;       // current word
+static int next_pixel = 0;      // LED that will latch next word
+
+void sim_reset(void)
+{
+    memset(&sim_counts, 0, sizeof(sim_counts));
+
+    free(sim_pixels);
+    sim_num_pixels = profile.num_pixels;
+    sim_pixels = calloc(sim_num_pixels, sizeof(Pixel));
+    sim_data = false;
+    zero_bits = 0;
+    word_bits = -1;
+    word = 0;
+    next_pixel = 0;
+}
+
+void sim_clock(bool data)
+{
+    sim_counts.clocks++;
+    if (sim_counts.clocks % 8 == 0) sim_counts.bytes++;
+
+    if (word_bits < 0) {
+        // waiting for first pixel word after start frame
+        if (!data) {
+            zero_bits++;
+            return;
+        }
+
+        if (zero_bits < 32) {
+            zero_bits = 0;
+            return;
+        }
+
+        word_bits = 0;
+        next_pixel = 0;
+    }
+
+    word = (word << 1) | data;
+    word_bits++;
+    zero_bits = data ? 0 : zero_bits + 1;
+
+    if (word_bits == 32) {
+        if ((word >> 29) == 0b111 && next_pixel < sim_num_pixels) {
+            // LEDs wired for profile color order
+            Pixel *p = &sim_pixels[next_pixel++];
+            uint8_t colors[3];
+            colors[profile.order[0]] = word >> 16;
+            colors[profile.order[1]] = word >> 8;
+            colors[profile.order[2]] = word;
+
+            p->brightness = (word >> 24) & 0x1F;
+            p->red = colors[0];
+            p->green = colors[1];
+            p->blue = colors[2];
+            sim_counts.latched++;
+
+        } else if ((word >> 29) != 0b111) {
+            // not a pixel word; end of frame, wait for next start frame
+            word_bits = -1;
+            word = 0;
+            return;
+        }
+
+        word_bits = 0;
+        word = 0;
+    }
+}
+
+static bool sim_init(void)
+{
+    sim_reset();
+    return true;
+}
+
+static void sim_write_edges(const Edge *edges, int count)
+{
+    int i;
+    for (i = 0; i < count; i++) {
+        if (edges[i] != EDGE_CLK) {
+            sim_data = edges[i] == EDGE_DAT1_CLK;
+            sim_counts.data_writes++;
+            frame_round_trips++;
+        }
+
+        sim_clock(sim_data);
+        frame_round_trips += 2;
+    }
+}
+
+static void sim_flush(void)
+{
+    sim_counts.frames++;
+}
+
+static void sim_close(void)
+{
+}
+
+static void sim_report(FILE *out)
+{
+    int k;
+
+    fprintf(out, "frames %lu, clocks %lu, data writes %lu, bytes %lu, pixels latched %lu\n",
+            sim_counts.frames, sim_counts.clocks, sim_counts.data_writes, sim_counts.bytes,
+            sim_counts.latched);
+    fprintf(out, "pin writes per frame: %d\n", frame_round_trips);
+    fprintf(out, "# brightness red green blue\n");
+    for (k = 0; k < sim_num_pixels; k++) {
+        fprintf(out, "%d      %2d    %3d  %3d  %3d\n",
+                k,
+                sim_pixels[k].brightness,
+                sim_pixels[k].red,
+                sim_pixels[k].green,
+                sim_pixels[k].blue);
+    }
+}
+
+const Backend sim_backend = {
+    "sim", sim_init, sim_write_edges, NULL, sim_flush, sim_close, sim_report
+};
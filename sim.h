@@ -0,0 +1,54 @@
+//
+// sim.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef sim_h
+#define sim_h
+
+#include <stdbool.h>
+
+#include "blinkt.h"
+
+// what the simulated chain has seen since sim_reset()
+struct SimCounts {
+    unsigned long frames;       // calls to flush
+    unsigned long clocks;       // rising clock edges
+    unsigned long data_writes;  // changes requested on data pin
+    unsigned long bytes;        // bytes clocked in, including start and end frames
+    unsigned long latched;      // pixel words latched by LEDs
+};
+typedef struct SimCounts SimCounts;
+
+extern SimCounts sim_counts;
+
+// colors latched by each simulated LED; brightness is the 5-bit value without header bits
+extern Pixel *sim_pixels;
+
+// clear counts and size simulated chain to current profile
+void sim_reset(void);
+
+// feed one rising clock edge with data pin at given level
+void sim_clock(bool data);
+
+#endif /* sim_h */
@@ -0,0 +1,422 @@
+//
+// state.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// The state file is a fixed binary layout that is mmapped, so reading it costs an open, an fstat
+// and an mmap. Writers update it in place while holding a write lock on the file; readers take no
+// lock and retry if the sequence counter was odd or changed while they copied (a seqlock), so they
+// never see a half-written state. The file never shrinks, so a mapping stays valid while another
+// process is writing. Text state files from older versions are converted the first time they are
+// read.
+//
+// Two advisory byte-range locks coordinate blinkt processes. The state lock is held across a whole
+// read, change and write, so concurrent updates are not lost. The bus lock is taken without
+// waiting by a process that wants to send a frame; a process that finds it taken just leaves its
+// change in the file, and the holder, after sending, checks the sequence counter and sends again
+// if the state moved on. Only the newest state is sent, however many updates arrive. Modes that
+// send their own frames, such as play or stream, wait for the bus lock before each frame instead.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blinkt.h"
+
+// buffer size for text state file
+#define LINE_SIZE 256
+
+#define STATE_MAGIC "BLKT"
+#define STATE_VERSION 1
+
+// reader retries before waiting on writer's lock
+#define SEQ_SPINS 100
+
+// byte ranges used as locks; they need not lie inside the file
+#define STATE_LOCK_BYTE 0
+#define BUS_LOCK_BYTE 1
+
+typedef struct {
+    char magic[4];          // STATE_MAGIC
+    uint32_t version;       // STATE_VERSION
+    uint32_t sequence;      // odd while a write is in progress
+    uint32_t num_pixels;
+    uint8_t left_to_right;
+    uint8_t leds_on;
+    uint8_t holding;
+    uint8_t binary_on;
+    uint8_t binary_mask;
+    uint8_t reserved[3];
+    Pixel pixels[];
+} StateFile;
+
+// state file currently mapped
+int state_fd = -1;
+bool state_writable = false;
+StateFile *state_map = NULL;
+size_t state_size = 0;
+dev_t state_dev;
+ino_t state_ino;
+bool state_locked = false;  // state lock held by begin_state_update()
+
+static size_t state_file_size(int num_pixels)
+{
+    return sizeof(StateFile) + num_pixels * sizeof(Pixel);
+}
+
+static bool is_state_file(const StateFile *map, size_t size)
+{
+    return size >= sizeof(StateFile) &&
+           memcmp(map->magic, STATE_MAGIC, 4) == 0 &&
+           map->version == STATE_VERSION &&
+           state_file_size(map->num_pixels) <= size;
+}
+
+// set lock on one byte; type is F_RDLCK, F_WRLCK or F_UNLCK. Return false if not set.
+static bool lock_byte(off_t byte, short type, bool wait)
+{
+    struct flock lock;
+    int result;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = byte;
+    lock.l_len = 1;
+
+    do {
+        result = fcntl(state_fd, wait ? F_SETLKW : F_SETLK, &lock);
+    } while (result != 0 && errno == EINTR);
+
+    return result == 0;
+}
+
+// take or release state lock, unless begin_state_update() already holds it
+static void lock_state_file(short type)
+{
+    if (!state_locked) lock_byte(STATE_LOCK_BYTE, type, true);
+}
+
+static void unmap_state_file(void)
+{
+    if (state_map != NULL) munmap(state_map, state_size);
+    if (state_fd >= 0) close(state_fd);
+
+    state_map = NULL;
+    state_size = 0;
+    state_fd = -1;
+}
+
+// map current size of open state file
+static bool map_state_file(void)
+{
+    struct stat statbuf;
+
+    if (state_map != NULL) munmap(state_map, state_size);
+    state_map = NULL;
+    state_size = 0;
+
+    if (fstat(state_fd, &statbuf) != 0) return false;
+    state_dev = statbuf.st_dev;
+    state_ino = statbuf.st_ino;
+    if (statbuf.st_size == 0) return true;
+
+    state_map = mmap(NULL, statbuf.st_size, state_writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, state_fd, 0);
+    if (state_map == MAP_FAILED) {
+        state_map = NULL;
+        return false;
+    }
+
+    state_size = statbuf.st_size;
+    return true;
+}
+
+// open and map path, unless already mapped and not replaced since
+static bool open_state_file(const char *path, bool writable)
+{
+    struct stat statbuf;
+
+    if (state_fd >= 0 && (state_writable || !writable) && stat(path, &statbuf) == 0 &&
+        statbuf.st_dev == state_dev && statbuf.st_ino == state_ino) {
+        return true;
+    }
+
+    unmap_state_file();
+
+    umask(0002);
+    state_fd = open(path, O_RDWR | (writable ? O_CREAT : 0), 0666);
+    state_writable = state_fd >= 0;
+    if (state_fd < 0 && !writable) state_fd = open(path, O_RDONLY);
+    if (state_fd < 0) return false;
+
+    if (!map_state_file()) {
+        unmap_state_file();
+        return false;
+    }
+
+    return true;
+}
+
+// make file big enough for num_pixels; caller holds write lock
+static bool grow_state_file(int num_pixels)
+{
+    size_t size = state_file_size(num_pixels);
+    struct stat statbuf;
+
+    // another process may have grown it already
+    if (fstat(state_fd, &statbuf) != 0) return false;
+    if ((size_t)statbuf.st_size > size) size = statbuf.st_size;
+    if ((size_t)statbuf.st_size < size && ftruncate(state_fd, size) != 0) return false;
+
+    return size == state_size || map_state_file();
+}
+
+// copy state into mapped file; caller holds write lock
+static void store_state(Flags flags, const Pixel pixels[])
+{
+    uint32_t sequence = __atomic_load_n(&state_map->sequence, __ATOMIC_RELAXED);
+
+    // an odd count here means a writer died mid-update; this write repairs it
+    if ((sequence & 1) == 0) sequence++;
+    __atomic_store_n(&state_map->sequence, sequence, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    state_map->num_pixels = profile.num_pixels;
+    state_map->left_to_right = flags.left_to_right;
+    state_map->leds_on = flags.leds_on;
+    state_map->holding = flags.holding;
+    state_map->binary_on = flags.binary_on;
+    state_map->binary_mask = flags.binary_mask;
+    memcpy(state_map->pixels, pixels, profile.num_pixels * sizeof(Pixel));
+    memcpy(state_map->magic, STATE_MAGIC, 4);
+    state_map->version = STATE_VERSION;
+
+    __atomic_store_n(&state_map->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+// copy state out of mapped file without tearing; false if file is not a state file.
+// locked is true if caller already holds a lock on the file.
+static bool load_state(Flags *flags, Pixel pixels[], bool locked)
+{
+    bool took_lock = false;
+    bool loaded = false;
+    int spins = 0;
+
+    for (;;) {
+        uint32_t sequence = __atomic_load_n(&state_map->sequence, __ATOMIC_ACQUIRE);
+        int num_pixels;
+
+        if ((sequence & 1) != 0 && !locked) {
+            // writer busy; yield a few times, then wait for its lock and copy under it
+            if (++spins < SEQ_SPINS) {
+                sched_yield();
+            } else {
+                lock_state_file(F_RDLCK);
+                locked = took_lock = true;
+            }
+            continue;
+        }
+
+        if (!is_state_file(state_map, state_size)) break;
+
+        num_pixels = state_map->num_pixels;
+        if (num_pixels > profile.num_pixels) num_pixels = profile.num_pixels;
+
+        // file from a shorter chain leaves remaining pixels as they were
+        flags->left_to_right = state_map->left_to_right;
+        flags->leds_on = state_map->leds_on;
+        flags->holding = state_map->holding;
+        flags->binary_on = state_map->binary_on;
+        flags->binary_mask = state_map->binary_mask;
+        memcpy(pixels, state_map->pixels, num_pixels * sizeof(Pixel));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        // under lock, an odd count is left by a writer that died; take what is there
+        if (locked || __atomic_load_n(&state_map->sequence, __ATOMIC_RELAXED) == sequence) {
+            loaded = true;
+            break;
+        }
+    }
+
+    if (took_lock) lock_state_file(F_UNLCK);
+
+    return loaded;
+}
+
+// parse state file written by earlier versions of blinkt
+static bool read_text_state(FILE *file, Flags *flags, Pixel pixels[])
+{
+    bool error = false;
+    char line[LINE_SIZE];
+    int k;
+
+    error = fgets(line, LINE_SIZE, file) == NULL;
+    if (!error) flags->left_to_right = strcmp(line, "left\n") == 0;
+
+    if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
+    if (!error) flags->leds_on = strcmp(line, "on\n") == 0;
+
+    if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
+    if (!error) flags->holding = strcmp(line, "on\n") == 0;
+
+    if (!error) error = fgets(line, LINE_SIZE, file) == NULL;
+    if (!error) flags->binary_on = strcmp(line, "on\n") == 0;
+
+    if (!error) error = fscanf(file, "%hhd", &flags->binary_mask) != 1;
+
+    for (k = 0; k < profile.num_pixels && !error; k++) {
+        int count = fscanf(file, "%hhd %hhd %hhd %hhd",
+                           &pixels[k].brightness,
+                           &pixels[k].blue,
+                           &pixels[k].green,
+                           &pixels[k].red);
+
+        // file from a shorter chain; leave remaining pixels cleared
+        if (count == EOF && k > 0) break;
+
+        error = count != 4;
+    }
+
+    return !error;
+}
+
+// read text or empty file, then rewrite it in binary if possible; false if text is bad
+static bool convert_state_file(Flags *flags, Pixel pixels[])
+{
+    bool ok = true;
+
+    if (state_writable) lock_state_file(F_WRLCK);
+
+    // another process may have converted it while we waited for lock
+    if (map_state_file() && state_map != NULL && load_state(flags, pixels, state_writable)) {
+        if (state_writable) lock_state_file(F_UNLCK);
+        return true;
+    }
+
+    if (state_size > 0) {
+        // parse mapping; closing another descriptor for the file would drop our locks
+        FILE *file = fmemopen(state_map, state_size, "r");
+
+        ok = file != NULL && read_text_state(file, flags, pixels);
+        if (file != NULL) fclose(file);
+    }
+
+    if (!ok) init_state(flags, pixels);
+
+    if (state_writable && grow_state_file(profile.num_pixels)) {
+        // readers see no magic until store_state() finishes, and wait for our lock
+        memset(state_map, 0, state_size);
+        store_state(*flags, pixels);
+    }
+
+    if (state_writable) lock_state_file(F_UNLCK);
+
+    return ok;
+}
+
+// read flags and pixels from state file, if it exists
+void read_state_file(const char *path, Flags *flags, Pixel pixels[])
+{
+    bool error = false;
+
+    if (open_state_file(path, false)) {
+        if (state_map == NULL || !load_state(flags, pixels, state_locked)) {
+            error = !convert_state_file(flags, pixels);
+        }
+    }
+
+    if (error) {
+        fprintf(stderr, "Error reading file %s\n", path);
+        // don't leave state half-read
+        init_state(flags, pixels);
+    }
+}
+
+bool begin_state_update(const char *path)
+{
+    if (open_state_file(path, true) && lock_byte(STATE_LOCK_BYTE, F_WRLCK, true)) {
+        state_locked = true;
+    }
+
+    return state_locked;
+}
+
+void end_state_update(void)
+{
+    if (state_locked) lock_byte(STATE_LOCK_BYTE, F_UNLCK, true);
+    state_locked = false;
+}
+
+bool try_lock_bus(void)
+{
+    return state_fd >= 0 && state_writable && lock_byte(BUS_LOCK_BYTE, F_WRLCK, false);
+}
+
+// wait for bus lock, for a process that must send its frame; false if state file cannot be locked
+bool lock_bus(void)
+{
+    return state_fd >= 0 && state_writable && lock_byte(BUS_LOCK_BYTE, F_WRLCK, true);
+}
+
+void unlock_bus(void)
+{
+    lock_byte(BUS_LOCK_BYTE, F_UNLCK, false);
+}
+
+// sequence counter, which changes with every write to state file
+uint32_t state_generation(void)
+{
+    if (state_map == NULL) return 0;
+    return __atomic_load_n(&state_map->sequence, __ATOMIC_ACQUIRE);
+}
+
+// write flags and pixels to state file
+void write_state_file(const char *path, Flags flags, Pixel pixels[])
+{
+    if (!open_state_file(path, true)) {
+        fprintf(stderr, "Unable to open %s for writing\n", path);
+
+    } else {
+        lock_state_file(F_WRLCK);
+
+        if (grow_state_file(profile.num_pixels)) {
+            store_state(flags, pixels);
+
+        } else {
+            fprintf(stderr, "Unable to write to %s\n", path);
+        }
+
+        lock_state_file(F_UNLCK);
+    }
+}
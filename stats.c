@@ -0,0 +1,295 @@
+//
+// stats.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Counters and frame timing collected across invocations, when the profile says "stats on". The
+// stats file is a fixed binary layout, mmapped shared, and every process adds to it with atomic
+// operations, so no locking is needed after the file is set up. Time in each phase of a blinkt
+// invocation comes from timing.c. Transmit times and the longest per-pixel gap are kept as
+// power-of-two histograms, which show stalls that an average would hide.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blinkt.h"
+#include "frame.h"
+#include "stats.h"
+#include "timing.h"
+
+#define STATS_MAGIC "BLKS"
+#define STATS_VERSION 2
+
+typedef struct {
+    char magic[4];          // STATS_MAGIC
+    uint32_t version;
+    uint64_t frames;
+    uint64_t frame_ns;      // total transmit time
+    uint64_t frame_max_ns;
+    uint64_t gap_max_ns;
+    uint64_t gpio_calls;    // GPIO calls or register writes, on every backend
+    uint64_t bytes;         // frame bytes sent
+    uint64_t invocations;   // blinkt commands run with state file
+    uint64_t skipped;       // of those, commands that changed nothing, so sent nothing
+    uint64_t phase_ns[NUM_PHASES];
+    uint64_t frame_histogram[STATS_BUCKETS];
+    uint64_t gap_histogram[STATS_BUCKETS];
+} StatsFile;
+
+static StatsFile *stats_map = NULL;
+static bool stats_failed = false;      // don't retry after failing to open
+
+// map stats file, creating or resetting it if needed; false if unavailable
+static bool open_stats(bool writable)
+{
+    struct flock lock;
+    struct stat statbuf;
+    int fd;
+
+    if (stats_map != NULL) return true;
+    if (stats_failed) return false;
+    stats_failed = true;
+
+    umask(0002);
+    fd = open(STATS_PATH, writable ? O_RDWR | O_CREAT : O_RDONLY, 0666);
+    if (fd < 0) return false;
+
+    // hold write lock while checking layout, so two processes don't both set it up
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = writable ? F_WRLCK : F_RDLCK;
+    lock.l_whence = SEEK_SET;
+    fcntl(fd, F_SETLKW, &lock);
+
+    if (fstat(fd, &statbuf) != 0 ||
+        ((size_t)statbuf.st_size < sizeof(StatsFile) && (!writable || ftruncate(fd, sizeof(StatsFile)) != 0))) {
+        close(fd);
+        return false;
+    }
+
+    stats_map = mmap(NULL, sizeof(StatsFile), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    if (stats_map == MAP_FAILED) {
+        stats_map = NULL;
+        close(fd);
+        return false;
+    }
+
+    if (writable && (memcmp(stats_map->magic, STATS_MAGIC, 4) != 0 || stats_map->version != STATS_VERSION)) {
+        memset(stats_map, 0, sizeof(StatsFile));
+        memcpy(stats_map->magic, STATS_MAGIC, 4);
+        stats_map->version = STATS_VERSION;
+    }
+
+    // mapping stays valid after close, which also releases lock
+    close(fd);
+    stats_failed = false;
+    return true;
+}
+
+static int bucket(int64_t ns)
+{
+    int64_t usec = ns / 1000;
+    int k = 0;
+
+    while (usec > 0 && k < STATS_BUCKETS - 1) {
+        usec >>= 1;
+        k++;
+    }
+
+    return k;
+}
+
+static void update_max(uint64_t *max, uint64_t value)
+{
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while (value > old && !__atomic_compare_exchange_n(max, &old, value, true, __ATOMIC_RELAXED,
+                                                       __ATOMIC_RELAXED)) {
+    }
+}
+
+void record_frame(int64_t start, int64_t gap)
+{
+    int64_t elapsed = now_ns() - start;
+
+    if (!open_stats(true)) return;
+    if (gap == 0) gap = elapsed;
+
+    __atomic_fetch_add(&stats_map->frames, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_map->gpio_calls, frame_round_trips, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_map->bytes, frame_bytes(), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_map->frame_ns, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_map->frame_histogram[bucket(elapsed)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_map->gap_histogram[bucket(gap)], 1, __ATOMIC_RELAXED);
+    update_max(&stats_map->frame_max_ns, elapsed);
+    update_max(&stats_map->gap_max_ns, gap);
+}
+
+void record_invocation(bool changed)
+{
+    int k;
+
+    if (!open_stats(true)) return;
+
+    __atomic_fetch_add(&stats_map->invocations, 1, __ATOMIC_RELAXED);
+    if (!changed) __atomic_fetch_add(&stats_map->skipped, 1, __ATOMIC_RELAXED);
+    for (k = 0; k < NUM_PHASES; k++) {
+        __atomic_fetch_add(&stats_map->phase_ns[k], phase_time(k), __ATOMIC_RELAXED);
+    }
+}
+
+static void print_histogram(const char *title, const uint64_t histogram[])
+{
+    int k;
+
+    printf("\n%s\n", title);
+    for (k = 0; k < STATS_BUCKETS; k++) {
+        if (histogram[k] == 0) continue;
+
+        if (k == 0) {
+            printf("  %9s %-9s %12llu\n", "", "< 1 us", (unsigned long long)histogram[k]);
+
+        } else if (k == STATS_BUCKETS - 1) {
+            printf("  %9ld %-9s %12llu\n", 1L << (k - 1), "us +", (unsigned long long)histogram[k]);
+
+        } else {
+            printf("  %9ld-%-9ld %12llu\n", 1L << (k - 1), 1L << k, (unsigned long long)histogram[k]);
+        }
+    }
+}
+
+static void print_text(const StatsFile *stats)
+{
+    uint64_t runs = stats->invocations > 0 ? stats->invocations : 1;
+    uint64_t frames = stats->frames > 0 ? stats->frames : 1;
+    int k;
+
+    printf("Invocations: %llu, %llu sent nothing\n", (unsigned long long)stats->invocations,
+           (unsigned long long)stats->skipped);
+    printf("Frames: %llu\n", (unsigned long long)stats->frames);
+    printf("GPIO calls: %llu, %.1f per frame\n", (unsigned long long)stats->gpio_calls,
+           (double)stats->gpio_calls / frames);
+    printf("Bytes sent: %llu\n", (unsigned long long)stats->bytes);
+    printf("Transmit time: %.1f us mean, %.1f us max\n", stats->frame_ns / 1e3 / frames,
+           stats->frame_max_ns / 1e3);
+    printf("Longest pixel: %.1f us\n", stats->gap_max_ns / 1e3);
+
+    printf("\nTime per invocation (us)\n");
+    for (k = 0; k < NUM_PHASES; k++) {
+        printf("  %-14s %10.1f\n", phase_name(k), stats->phase_ns[k] / 1e3 / runs);
+    }
+
+    print_histogram("Transmit time per frame (us)", stats->frame_histogram);
+    print_histogram("Longest pixel per frame (us)", stats->gap_histogram);
+}
+
+// histogram as array of counts, bucket k ending at 2^k us
+static void print_json_histogram(const char *name, const uint64_t histogram[], bool last)
+{
+    int k;
+
+    printf("  \"%s\": [", name);
+    for (k = 0; k < STATS_BUCKETS; k++) {
+        printf("%s%llu", k > 0 ? ", " : "", (unsigned long long)histogram[k]);
+    }
+    printf("]%s\n", last ? "" : ",");
+}
+
+static void print_json(const StatsFile *stats)
+{
+    int k;
+
+    printf("{\n");
+    printf("  \"invocations\": %llu,\n", (unsigned long long)stats->invocations);
+    printf("  \"skipped\": %llu,\n", (unsigned long long)stats->skipped);
+    printf("  \"frames\": %llu,\n", (unsigned long long)stats->frames);
+    printf("  \"gpio_calls\": %llu,\n", (unsigned long long)stats->gpio_calls);
+    printf("  \"bytes\": %llu,\n", (unsigned long long)stats->bytes);
+    printf("  \"frame_ns\": %llu,\n", (unsigned long long)stats->frame_ns);
+    printf("  \"frame_max_ns\": %llu,\n", (unsigned long long)stats->frame_max_ns);
+    printf("  \"gap_max_ns\": %llu,\n", (unsigned long long)stats->gap_max_ns);
+
+    printf("  \"phase_ns\": {");
+    for (k = 0; k < NUM_PHASES; k++) {
+        const char *c;
+
+        printf("%s\"", k > 0 ? ", " : "");
+        for (c = phase_name(k); *c != '\0'; c++) putchar(*c == ' ' ? '_' : *c);
+        printf("\": %llu", (unsigned long long)stats->phase_ns[k]);
+    }
+    printf("},\n");
+
+    print_json_histogram("frame_histogram", stats->frame_histogram, false);
+    print_json_histogram("gap_histogram", stats->gap_histogram, true);
+    printf("}\n");
+}
+
+int run_stats(int argc, const char *argv[])
+{
+    bool reset = argc == 3 && strcmp(argv[2], "reset") == 0;
+    bool json = argc == 3 && strcmp(argv[2], "--json") == 0;
+    StatsFile stats;
+
+    if (argc > 3 || (argc == 3 && !reset && !json)) {
+        fprintf(stderr, "Usage: blinkt stats [--json | reset]\n");
+        return 1;
+    }
+
+    if (reset) {
+        if (!open_stats(true)) {
+            perror(STATS_PATH);
+            return 1;
+        }
+
+        memset(&stats_map->frames, 0, sizeof(StatsFile) - offsetof(StatsFile, frames));
+        return 0;
+    }
+
+    // nothing recorded yet reads as all zero
+    if (open_stats(false) && memcmp(stats_map->magic, STATS_MAGIC, 4) == 0 &&
+        stats_map->version == STATS_VERSION) {
+        memcpy(&stats, stats_map, sizeof(stats));
+
+    } else {
+        memset(&stats, 0, sizeof(stats));
+        if (!json) printf("No stats recorded; put \"stats on\" in %s\n\n", PROFILE_PATH);
+    }
+
+    if (json) {
+        print_json(&stats);
+
+    } else {
+        print_text(&stats);
+    }
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+//
+// stats.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef stats_h
+#define stats_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STATS_PATH "/usr/local/share/blinkt.stats"
+
+// histogram buckets: bucket 0 is under 1 us, bucket k is 2^(k-1) us up to 2^k us, last is the rest
+#define STATS_BUCKETS 24
+
+// add frame sent since start (from now_ns() in timing.h) to the stats file; gap is the longest time taken by any one pixel's
+// clocks, or 0 if the frame went out in a single call
+void record_frame(int64_t start, int64_t gap);
+
+// add this invocation's phase times to the stats file; changed is false if it sent nothing
+void record_invocation(bool changed);
+
+// print or clear stats file: blinkt stats [--json | reset]
+int run_stats(int argc, const char *argv[]);
+
+#endif /* stats_h */
@@ -0,0 +1,182 @@
+//
+// stream.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// raw frame streaming, like ffmpeg's rawvideo: each frame is num_pixels pixels in chain order,
+// 3 bytes red, green, blue (rgb24) or 4 bytes with brightness last (rgba). Frames are read into
+// one buffer and built straight into the wire frame, with no state file or Pixel array in
+// between. With --latest, frames already waiting behind the one just read are skipped, so a
+// producer faster than the LEDs never builds up a backlog.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+
+#include "blinkt.h"
+#include "frame.h"
+#include "mode.h"
+#include "stream.h"
+#include "timing.h"
+
+// read exactly size bytes; false at end of input, on error, or when stopped
+static bool read_frame(int fd, uint8_t *buffer, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size && !stop_requested) {
+        ssize_t count = read(fd, buffer + done, size - done);
+
+        if (count > 0) {
+            done += count;
+
+        } else if (count == 0 || errno != EINTR) {
+            if (count < 0) perror("stream");
+            if (done > 0) fprintf(stderr, "stream: last frame cut short\n");
+            return false;
+        }
+    }
+
+    return done == size;
+}
+
+int run_stream(int argc, const char *argv[])
+{
+    const char *path = "-";
+    int bytes_per_pixel = 3;
+    int brightness = 7;
+    bool latest = false;
+    size_t size;
+    uint8_t *raw;           // last complete frame
+    uint8_t *next;          // frame being read, which may be cut short
+    uint8_t *swap;
+    int fd;
+    long frames = 0;
+    long skipped = 0;
+    int64_t start;
+    int64_t elapsed;
+    Pixel *pixels;
+    Flags flags;
+    int k;
+
+    for (k = 2; k < argc; k++) {
+        if (strcmp(argv[k], "--format") == 0 && k + 1 < argc) {
+            k++;
+            bytes_per_pixel = strcmp(argv[k], "rgba") == 0 ? 4 :
+                              strcmp(argv[k], "rgb24") == 0 || strcmp(argv[k], "rgb") == 0 ? 3 : 0;
+
+        } else if (strcmp(argv[k], "--bright") == 0 && k + 1 < argc) {
+            brightness = parse_num(argv[++k], 10);
+
+        } else if (strcmp(argv[k], "--latest") == 0) {
+            latest = true;
+
+        } else {
+            path = argv[k];
+        }
+    }
+
+    if (bytes_per_pixel == 0 || brightness < 0 || brightness > 31) {
+        fprintf(stderr, "Usage: blinkt stream [<path>] [--format rgb24 | rgba] [--bright 0-31] [--latest]\n");
+        return 1;
+    }
+
+    pixels = begin_mode(&flags);
+    size = (size_t)profile.num_pixels * bytes_per_pixel;
+
+    // opening a FIFO waits here for a writer
+    fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        free(pixels);
+        return 1;
+    }
+
+    raw = malloc(size);
+    next = malloc(size);
+    if (raw == NULL || next == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    start = now_ns();
+
+    // a frame is kept only once it has been read in full, so one cut short at end of input is
+    // neither sent nor saved
+    while (read_frame(fd, next, size)) {
+        swap = raw;
+        raw = next;
+        next = swap;
+
+        if (latest) {
+            int waiting;
+
+            while (ioctl(fd, FIONREAD, &waiting) == 0 && waiting >= (int)size &&
+                   read_frame(fd, next, size)) {
+                swap = raw;
+                raw = next;
+                next = swap;
+                skipped++;
+            }
+        }
+
+        build_raw_frame(raw, bytes_per_pixel, brightness, get_frame_buffer());
+        send_mode_frame();
+        frames++;
+    }
+
+    elapsed = now_ns() - start;
+
+    // leave last frame in state file, so later commands start from it
+    if (frames > 0) {
+        flags.leds_on = true;
+        flags.holding = false;
+        flags.binary_on = false;
+
+        for (k = 0; k < profile.num_pixels; k++) {
+            const uint8_t *p = raw + k * bytes_per_pixel;
+
+            pixels[k].red = p[0];
+            pixels[k].green = p[1];
+            pixels[k].blue = p[2];
+            pixels[k].brightness = bytes_per_pixel == 4 ? p[3] >> 3 : brightness;
+        }
+    }
+
+    if (fd != STDIN_FILENO) close(fd);
+    end_mode(flags, pixels, frames > 0);
+    free(raw);
+    free(next);
+
+    fprintf(stderr, "%ld frames in %.3f s, %ld skipped, %.1f fps\n",
+            frames, elapsed / 1e9, skipped, elapsed > 0 ? frames * 1e9 / elapsed : 0.0);
+
+    return 0;
+}
@@ -29,25 +29,28 @@
 
 #include "text.h"
 
-void version(void)
+void version(FILE *out)
 {
-    printf("blinkt 0.4\n");
+    fprintf(out, "blinkt 0.4\n");
 }
 
-void usage(void)
+void usage(FILE *out)
 {
-    printf("blinkt - controls the LEDs on the Blinkt! board for Raspberry Pi.\n"
+    fprintf(out, "blinkt - controls the LEDs on the Blinkt! board for Raspberry Pi.\n"
            "\n"
            "Usage:\n"
            "  blinkt <color>\n"
            "  blinkt rgb <0-255> <0-255> <0-255>\n"
            "  blinkt bright <0-31>\n"
            "  blinkt clear\n"
+           "  blinkt fade [bright <0-31>] [<color> | rgb <0-255> <0-255> <0-255>] <milliseconds> [linear | ease]\n"
            "  blinkt delay <milliseconds>\n"
            "\n"
            "  blinkt <select> <color>\n"
            "  blinkt <select> rgb <0-255> <0-255> <0-255>\n"
            "  blinkt <select> bright <0-31>\n"
+           "  blinkt <select> fade <color> <milliseconds>\n"
+           "  blinkt <select> effect <effect> [<color> | rgb <0-255> <0-255> <0-255>] [<period>]\n"
            "\n"
            "  blinkt <left | right>\n"
            "  blinkt <off | on>\n"
@@ -57,8 +60,22 @@ void usage(void)
            "  blinkt binary <mask>\n"
            "  blinkt <select> binary <mask>\n"
            "  blinkt binary off\n"
+           "  blinkt binary <up | down>\n"
            "\n"
            "  blinkt state\n"
+           "  blinkt refresh\n"
+           "  blinkt <command> [<command> ...]\n"
+           "  blinkt -f <script>\n"
+           "  blinkt -\n"
+           "  blinkt --timing <command>\n"
+           "  blinkt animate <command> [--fps <frames per second>] [--count <frames>]\n"
+           "  blinkt compile <script> <file> [--fps <frames per second>]\n"
+           "  blinkt play <file> [--loop]\n"
+           "  blinkt stream [<file>] [--format rgb24 | rgba] [--bright <0-31>] [--latest]\n"
+           "  blinkt opc [--port <1-65535>] [--channel <1-255>]\n"
+           "  blinkt dmx (e131 | artnet) [--universe <number>] [--address <1-510>] [--port <1-65535>]\n"
+           "  blinkt meter (cpu | load | mem | disk) [--interval <msec>] [--warn <0-100>] [--alert <0-100>] [--binary]\n"
+           "  blinkt stats [--json | reset]\n"
            "  blinkt help\n"
            "  blinkt version\n"
            "  blinkt license\n"
@@ -73,12 +90,14 @@ void usage(void)
            "  <off | on>      off = turn off all LEDs, on = turn as they were before\n"
            "  <hold | show>   hold = save commands without changing LEDs, show = change LEDs immediately\n"
            "  <left | right | in | out>   rotate LEDs according to specified pattern\n"
-           "  <mask>          number 0-255 to use as binary mask\n");
+           "  <mask>          number 0-255 to use as binary mask\n"
+           "  <up | down>     add or subtract 1 from number shown in binary\n"
+           "  <effect>        rainbow breathe chase larson sparkle wipe; run with animate\n");
 }
 
-void license(void)
+void license(FILE *out)
 {
-    printf("Copyright (C) 2022 Michael Budiansky. All rights reserved.\n"
+    fprintf(out, "Copyright (C) 2022 Michael Budiansky. All rights reserved.\n"
            "\n"
            "Redistribution and use in source and binary forms, with or without modification, are permitted\n"
            "provided that the following conditions are met:\n"
@@ -105,9 +124,9 @@ void license(void)
            "\n");
 }
 
-void man_page_source(void)
+void man_page_source(FILE *out)
 {
-    printf(".TH blinkt 1\n"
+    fprintf(out, ".TH blinkt 1\n"
            "\n"
            ".SH NAME\n"
            "blinkt \\- controls the LEDs on the Blinkt! board for Raspberry Pi\n"
@@ -118,13 +137,27 @@ void man_page_source(void)
            "\\fBblinkt\\fR [\\fISELECT\\fR] \\fBrgb\\fR \\fIRED\\fR \\fIGREEN\\fR \\fIBLUE\\fR\n"
            "\\fBblinkt\\fR \\fBbright\\fR \\fIBRIGHTNESS\\fR\n"
            "\\fBblinkt\\fR \\fBclear\\fR\n"
+           "\\fBblinkt\\fR [\\fISELECT\\fR] \\fBfade\\fR [\\fBbright\\fR \\fIBRIGHTNESS\\fR] [\\fICOLOR\\fR | \\fBrgb\\fR \\fIRED\\fR \\fIGREEN\\fR \\fIBLUE\\fR] \\fIMILLISECONDS\\fR [\\fBlinear\\fR | \\fBease\\fR]\n"
+           "\\fBblinkt\\fR [\\fISELECT\\fR] \\fBeffect\\fR \\fIEFFECT\\fR [\\fICOLOR\\fR | \\fBrgb\\fR \\fIRED\\fR \\fIGREEN\\fR \\fIBLUE\\fR] [\\fIPERIOD\\fR]\n"
            "\\fBblinkt\\fR \\fBdelay\\fR \\fIMILLISECONDS\\fR\n"
            "\\fBblinkt\\fR (\\fBleft\\fR | \\fBright\\fR)\n"
            "\\fBblinkt\\fR (\\fBoff\\fR | \\fBon\\fR)\n"
            "\\fBblinkt\\fR (\\fBhold\\fR | \\fBshow\\fR)\n"
            "\\fBblinkt\\fR \\fBrotate\\fR (\\fBleft\\fR | \\fBright\\fR | \\fBin\\fR | \\fBout\\fR)\n"
-           "\\fBblinkt\\fR [\\fISELECT\\fR] \\fBbinary\\fR (\\fBoff\\fR | \\fIMASK\\fR)\n"
+           "\\fBblinkt\\fR [\\fISELECT\\fR] \\fBbinary\\fR (\\fBoff\\fR | \\fIMASK\\fR | \\fBup\\fR | \\fBdown\\fR)\n"
            "\\fBblinkt\\fR \\fBstate\\fR\n"
+           "\\fBblinkt\\fR \\fBrefresh\\fR\n"
+           "\\fBblinkt\\fR \\fICOMMAND\\fR [\\fICOMMAND\\fR ...]\n"
+           "\\fBblinkt\\fR (\\fB\\-f\\fR \\fISCRIPT\\fR | \\fB\\-\\fR)\n"
+           "\\fBblinkt\\fR \\fB\\-\\-timing\\fR \\fICOMMAND\\fR\n"
+           "\\fBblinkt\\fR \\fBanimate\\fR \\fICOMMAND\\fR [\\fB\\-\\-fps\\fR \\fIFPS\\fR] [\\fB\\-\\-count\\fR \\fIFRAMES\\fR]\n"
+           "\\fBblinkt\\fR \\fBcompile\\fR \\fISCRIPT\\fR \\fIFILE\\fR [\\fB\\-\\-fps\\fR \\fIFPS\\fR]\n"
+           "\\fBblinkt\\fR \\fBplay\\fR \\fIFILE\\fR [\\fB\\-\\-loop\\fR]\n"
+           "\\fBblinkt\\fR \\fBstream\\fR [\\fIFILE\\fR] [\\fB\\-\\-format\\fR (\\fBrgb24\\fR | \\fBrgba\\fR)] [\\fB\\-\\-bright\\fR \\fIBRIGHTNESS\\fR] [\\fB\\-\\-latest\\fR]\n"
+           "\\fBblinkt\\fR \\fBopc\\fR [\\fB\\-\\-port\\fR \\fIPORT\\fR] [\\fB\\-\\-channel\\fR \\fICHANNEL\\fR]\n"
+           "\\fBblinkt\\fR \\fBdmx\\fR (\\fBe131\\fR | \\fBartnet\\fR) [\\fB\\-\\-universe\\fR \\fIUNIVERSE\\fR] [\\fB\\-\\-address\\fR \\fIADDRESS\\fR] [\\fB\\-\\-port\\fR \\fIPORT\\fR]\n"
+           "\\fBblinkt\\fR \\fBmeter\\fR (\\fBcpu\\fR | \\fBload\\fR | \\fBmem\\fR | \\fBdisk\\fR) [\\fB\\-\\-interval\\fR \\fIMSEC\\fR] [\\fB\\-\\-warn\\fR \\fIPERCENT\\fR] [\\fB\\-\\-alert\\fR \\fIPERCENT\\fR] [\\fB\\-\\-binary\\fR]\n"
+           "\\fBblinkt\\fR \\fBstats\\fR [\\fB\\-\\-json\\fR | \\fBreset\\fR]\n"
            "\\fBblinkt\\fR (\\fBhelp\\fR | \\fBversion\\fR | \\fBlicense\\fR | \\fBman\\-page\\fR)\n"
            ".fi\n"
            "\n"
@@ -178,6 +211,27 @@ void man_page_source(void)
            "Set RGB to 0 0 0 and brightness to 7 for all LEDs. Turn off holding and binary mode.\n"
            "\n"
            ".TP\n"
+           ".BR fade\n"
+           "Change color and/or brightness of the selected LEDs gradually over \\fIMILLISECONDS\\fR, sending as\n"
+           "many frames as the LEDs can take, up to 1000 a second. \\fBlinear\\fR (the default) changes at a\n"
+           "steady rate; \\fBease\\fR starts and ends slowly. The new state is saved before the fade starts, so\n"
+           "other blinkt commands don't wait for it; one that changes the LEDs ends the fade and shows its own\n"
+           "state.\n"
+           "\n"
+           ".TP\n"
+           ".BR effect\n"
+           "Draw one frame of \\fIEFFECT\\fR in the selected LEDs, in \\fICOLOR\\fR (default white). Effects are\n"
+           "timed by the clock, so use them with \\fBanimate\\fR to see them move.\n"
+           "\\fIPERIOD\\fR is milliseconds per cycle. \\fIEFFECT\\fR is one of:\n"
+           "\\fBrainbow\\fR (colors of the rainbow across the board, turning; color is not used; default 5000),\n"
+           "\\fBbreathe\\fR (brighten and dim smoothly; default 4000),\n"
+           "\\fBchase\\fR (one LED running left to right; default 1000),\n"
+           "\\fBlarson\\fR (a glow sweeping back and forth; default 2000),\n"
+           "\\fBsparkle\\fR (LEDs light at random and fade; here \\fIPERIOD\\fR is the chance in 256 that an LED\n"
+           "lights on each frame, default 16), and\n"
+           "\\fBwipe\\fR (fill from left to right, then start again; default 2000).\n"
+           "\n"
+           ".TP\n"
            ".BR delay\n"
            "Sleep for specified time.\n"
            "\n"
@@ -218,10 +272,110 @@ void man_page_source(void)
            "Decimal number (0-255) to display as binary in LEDs. Specify \"off\" to exit binary mode.\n"
            "\n"
            ".TP\n"
+           ".BR up \" | \" down\n"
+           "Add or subtract 1 from the number shown in binary, starting from 1 or 255 if binary mode is off.\n"
+           "\n"
+           ".TP\n"
            ".BR state\n"
            "Print out state of LEDs.\n"
            "\n"
            ".TP\n"
+           ".BR refresh\n"
+           "Send current state to LEDs again, and print what it cost, e.g. the number of calls made to the\n"
+           "pigpiod daemon to send the frame. When pigpiod is running, each frame is sent as a single waveform; if the daemon\n"
+           "cannot create the waveform, each clock and data transition is sent separately.\n"
+           "\n"
+           ".TP\n"
+           ".BR \\-f \" \" \\fISCRIPT\\fR\n"
+           "Run commands from \\fISCRIPT\\fR, one command per line without the leading \\fBblinkt\\fR, in a\n"
+           "single process. Blank lines and text after \\fB#\\fR are ignored. The GPIO pins are opened once, and\n"
+           "each command updates the state file as it would when run on its own. Each \\fBdelay\\fR is\n"
+           "measured from the start of the script rather than from the end of the previous command, so\n"
+           "animations keep exact time.\n"
+           "\n"
+           ".TP\n"
+           ".BR \\-\n"
+           "Same as \\fB\\-f\\fR, reading commands from standard input.\n"
+           "\n"
+           ".TP\n"
+           ".BR \\-\\-timing\n"
+           "Run \\fICOMMAND\\fR, then print to standard error how long each part took: CPU time used before the\n"
+           "program started running, loading the state file, the command itself, opening the GPIO pins,\n"
+           "sending the frame, and saving the state file. The GPIO pins are opened only when a frame has to be\n"
+           "sent, so commands like \\fBstate\\fR or a color that is already shown do not open them.\n"
+           "\n"
+           ".TP\n"
+           ".BR animate\n"
+           "Repeat \\fICOMMAND\\fR once per frame at \\fIFPS\\fR frames per second (1\\-1000, default 10), for\n"
+           "\\fIFRAMES\\fR frames or until interrupted. Frame times are fixed from the start, so the animation\n"
+           "does not drift; if a frame is already a whole frame late, it is dropped rather than shown late.\n"
+           "When done, prints the number of frames shown and dropped and the frame rate achieved.\n"
+           "\n"
+           ".TP\n"
+           ".BR compile\n"
+           "Record \\fISCRIPT\\fR, written as for \\fB\\-f\\fR, as an animation \\fIFILE\\fR of \\fIFPS\\fR frames per\n"
+           "second (default 30). The script starts from cleared LEDs and does not change the LEDs or the state\n"
+           "file; each frame holds what the LEDs would show at that time, and a last frame holds the final\n"
+           "state. Effects are drawn at their time in the script, and each frame of a \\fBfade\\fR holds the\n"
+           "fade's step at that time; a later command that changes the LEDs ends the fade. Frames that change only a few LEDs are stored as changes when that makes the file smaller.\n"
+           "\n"
+           ".TP\n"
+           ".BR play\n"
+           "Show the frames of an animation \\fIFILE\\fR at the rate it was recorded, dropping frames that\n"
+           "would be late, then print the number shown and dropped. With \\fB\\-\\-loop\\fR, repeat until\n"
+           "interrupted. The file is read as it plays, so it can be any length. The last frame shown is\n"
+           "saved as the LED state.\n"
+           "\n"
+           ".TP\n"
+           ".BR stream\n"
+           "Send raw frames from \\fIFILE\\fR, which may be a named pipe, or from standard input, to the LEDs\n"
+           "as fast as they arrive. Each frame has one entry per LED, in order along the chain: \\fBrgb24\\fR\n"
+           "(the default) is red, green and blue bytes, shown at \\fIBRIGHTNESS\\fR (default 7); \\fBrgba\\fR adds\n"
+           "a fourth byte, 0\\-255, used as brightness. With \\fB\\-\\-latest\\fR, frames that arrive faster than\n"
+           "the LEDs can take them are skipped, so only the newest is shown. At end of input, prints to\n"
+           "standard error the number of frames shown and skipped, and saves the last frame as the LED state.\n"
+           "\n"
+           ".TP\n"
+           ".BR opc\n"
+           "Listen on TCP \\fIPORT\\fR (default 7890) for Open Pixel Control clients, any number at once, and\n"
+           "show the colors they send. Set pixel colors messages for \\fICHANNEL\\fR (default 1) or for\n"
+           "channel 0 set pixels from the left end of the board, at the current brightness; other messages\n"
+           "are ignored. When messages arrive faster than the LEDs can take them, only the newest colors are\n"
+           "shown. When interrupted, prints to standard error the number of messages and frames and the frame\n"
+           "rate, and saves the colors as the LED state.\n"
+           "\n"
+           ".TP\n"
+           ".BR dmx\n"
+           "Receive DMX over UDP as E1.31 (sACN, default port 5568, universe 1) or Art\\-Net (default port\n"
+           "6454, universe 0) and show it. Each LED, from the left end of the board, takes three slots (red,\n"
+           "green, blue) starting at \\fIADDRESS\\fR (default 1), at the current brightness. Packets older than\n"
+           "the last one received are dropped. When interrupted, prints to standard error the number of\n"
+           "packets, stale packets and frames, and the time from receiving a packet to sending its frame, and\n"
+           "saves the colors as the LED state.\n"
+           "\n"
+           ".TP\n"
+           ".BR meter\n"
+           "Show a system measurement as a percentage, updated every \\fIMSEC\\fR milliseconds (default 1000)\n"
+           "until interrupted: \\fBcpu\\fR is the time the CPUs are busy, \\fBload\\fR is the 1\\-minute load\n"
+           "average per CPU, \\fBmem\\fR is the memory in use, and \\fBdisk\\fR is the time the busiest disk\n"
+           "spends doing I/O. The percentage is shown as a bar from the left end of the board, or with\n"
+           "\\fB\\-\\-binary\\fR as a binary number, in green, yellow from the \\fB\\-\\-warn\\fR percentage\n"
+           "(default 70) and red from the \\fB\\-\\-alert\\fR percentage (default 90), at the current\n"
+           "brightness.\n"
+           "\n"
+           ".TP\n"
+           ".BR stats\n"
+           "Show counters and timing collected by every blinkt and blinktd process since the last\n"
+           "\\fBreset\\fR, when the profile has \\fBstats on\\fR: the number of commands run and how many of them\n"
+           "changed nothing and sent nothing, frames, GPIO calls and bytes sent, the mean time per command\n"
+           "spent loading state, running the command, opening GPIO, sending frames, saving state and closing\n"
+           "GPIO, the mean and longest time to send a frame, and the longest time any one LED's clock pulses\n"
+           "took, which bounds the longest stall between edges. Both frame times are also shown as histograms,\n"
+           "in microseconds. With \\fB\\-\\-json\\fR, print the raw totals in nanoseconds as JSON, with each\n"
+           "histogram as an array whose entry \\fIk\\fR counts frames under 2^\\fIk\\fR microseconds. With\n"
+           "\\fBreset\\fR, clear them.\n"
+           "\n"
+           ".TP\n"
            ".BR help\n"
            "Show help message.\n"
            "\n"
@@ -318,6 +472,67 @@ void man_page_source(void)
            ".fi\n"
            ".PP\n"
            "\n"
+           "Move a red LED along the board at 30 frames per second, ten times:\n"
+           ".PP\n"
+           ".nf\n"
+           ".RS\n"
+           "\\fBblinkt clear\\fR\n"
+           "\\fBblinkt p0 red\\fR\n"
+           "\\fBblinkt animate rotate right \\-\\-fps 30 \\-\\-count 80\\fR\n"
+           ".RE\n"
+           ".fi\n"
+           ".PP\n"
+           "\n"
+           "Sweep a red glow back and forth until interrupted:\n"
+           ".PP\n"
+           ".nf\n"
+           ".RS\n"
+           "\\fBblinkt animate effect larson red \\-\\-fps 60\\fR\n"
+           ".RE\n"
+           ".fi\n"
+           ".PP\n"
+           "\n"
+           ".SH ENVIRONMENT\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_SOCKET\n"
+           "Socket where \\fBblinktd\\fR listens. Default is \\fI/run/blinkt/blinkt.sock\\fR. blinktd creates\n"
+           "the directory, writable only by its own user, so no one else can replace the socket. Any local\n"
+           "user may connect to the socket and send commands.\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_PROFILE\n"
+           "Profile to use instead of \\fI/usr/local/share/blinkt.conf\\fR.\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_BACKEND\n"
+           "How the LEDs are driven. \\fBpigpiod\\fR uses the pigpiod daemon. \\fBpigpio\\fR links the pigpio\n"
+           "library directly, which needs root. \\fBgpiod\\fR uses the Linux GPIO character device, which needs\n"
+           "neither the daemon nor root; membership in the group that owns the device (usually \\fBgpio\\fR) is\n"
+           "enough. \\fBgpiomem\\fR writes the GPIO registers directly through \\fI/dev/gpiomem\\fR, which is\n"
+           "fastest, also needs only the \\fBgpio\\fR group, and works on models up to the Pi 4. \\fBsim\\fR sends frames to a simulated chain of LEDs in memory; \\fBblinkt refresh\\fR then\n"
+           "prints what the simulated LEDs received. By default, pigpiod is used if running, otherwise the pigpio\n"
+           "library.\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_GPIOCHIP\n"
+           "GPIO character device used by the \\fBgpiod\\fR backend. Default is \\fI/dev/gpiochip0\\fR. On a\n"
+           "Raspberry Pi 5, use the chip labelled \\fBpinctrl\\-rp1\\fR. Any chip with at least 25 lines works,\n"
+           "including one created by the kernel \\fBgpio\\-sim\\fR module for testing.\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_GPIOMEM\n"
+           "Register block used by the \\fBgpiomem\\fR backend. Default is \\fI/dev/gpiomem\\fR. If this names a\n"
+           "regular file, the file stands in for the registers, and \\fBblinkt refresh\\fR prints what a chain of\n"
+           "LEDs would have received.\n"
+           "\n"
+           ".TP\n"
+           ".BR BLINKT_OUTPUT\n"
+           "How frames are sent to the LEDs. \\fBbbspi\\fR sends each frame as one bit\\-banged SPI transfer;\n"
+           "this also claims GPIO 22 and 25, which are not connected to the Blinkt! board. \\fBedges\\fR sends\n"
+           "each clock and data transition separately. By default, frames are sent to pigpiod as a single\n"
+           "waveform, or edge by edge when not using the daemon.\n"
+           "\n"
            ".SH NOTES\n"
            "The Blinkt! board is manufactured by Pimoroni in the UK\n"
            "<\\fIhttps://shop.pimoroni.com/products/blinkt\\fR>.\n"
@@ -326,10 +541,41 @@ void man_page_source(void)
            "After each invocation of the tool, the LED state is saved in the file "
            "\\fI/usr/local/share/blinkt\\fR\n"
            "\n"
+           "When several blinkt commands run at once, each change is saved in turn, so none is lost. Only one\n"
+           "process at a time sends to the LEDs; a command that finds another one sending leaves its change\n"
+           "for that process to send and exits at once.\n"
+           "\n"
+           "Any number of the commands above, each with its own \\fISELECT\\fR, can be given at once, as in\n"
+           "\\fBblinkt p1 red p2 blue bright 3\\fR. They are applied in order, and the LEDs and state file are\n"
+           "updated once at the end. A \\fBdelay\\fR among them splits the line: the commands before it are\n"
+           "shown and saved, then the delay is waited out before the commands after it are applied. Bare digits right after \\fBeffect\\fR are read as its \\fIPERIOD\\fR, so\n"
+           "to follow an effect with a \\fISELECT\\fR pattern, give the period first or write the pattern with\n"
+           "a b prefix, as in \\fBb11110000\\fR.\n"
+           "\n"
+           "For scripts that run blinkt many times a second, start \\fBblinktd\\fR. It keeps the GPIO pins open\n"
+           "and the LED state in memory, and blinkt passes each command to it instead of setting up GPIO\n"
+           "itself. The state file is then written at most once a second, and when blinktd exits. If blinktd\n"
+           "is not running, blinkt works on its own. Through blinktd, \\fBdelay\\fR is waited out by blinkt,\n"
+           "and \\fBfade\\fR returns at once while blinktd runs it; the next command that changes the LEDs\n"
+           "ends it. While blinktd is running, \\fBplay\\fR, \\fBstream\\fR, \\fBopc\\fR, \\fBdmx\\fR and\n"
+           "\\fBmeter\\fR refuse to start, since blinktd owns the GPIO pins.\n"
+           "\n"
            "To use number bases other than the default, preceed numbers by b for binary, d for\n"
            "decimal, x for hexadecimal. To use a number corresponding to a specific pixel, use\n"
            "p0, p1, p2, etc.\n"
            "\n"
+           "Other chains of APA102 LEDs can be described in the profile \\fI/usr/local/share/blinkt.conf\\fR. Each\n"
+           "line is a keyword and a value: \\fBpixels\\fR (number of LEDs, default 8), \\fBdat\\fR and \\fBclk\\fR (two\n"
+           "different GPIO numbers 0\\-53, default 23 and 24), \\fBorder\\fR (order of colors on the wire, default\n"
+           "bgr), \\fBgamma\\fR (\\fBon\\fR to correct colors for the eye's response, default \\fBoff\\fR), and\n"
+           "\\fBdither\\fR (with gamma, carry the fraction of each level over to following frames so that fades\n"
+           "stay smooth, default \\fBon\\fR). For steadier timing on a busy system, \\fBrealtime\\fR (1\\-99, default \\fBoff\\fR) sends\n"
+           "each frame at that SCHED_FIFO priority with its buffers locked in memory, and \\fBcpu\\fR (default\n"
+           "\\fBany\\fR) sends it from one CPU; both need root, and last only while the frame goes out. \\fBstats\\fR (\\fBon\\fR to record frame timing for \\fBblinkt stats\\fR,\n"
+           "default \\fBoff\\fR) adds a little time to each frame. On chains\n"
+           "longer than 8 LEDs, each bit of \\fISELECT\\fR and \\fIMASK\\fR covers one eighth of the chain, and\n"
+           "p0, p1, etc. select those eighths.\n"
+           "\n"
            ".SH AUTHOR\n"
            "Michael Budiansky \\fIhttps://www.7402.org/email\\fR\n");
 }
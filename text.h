@@ -27,10 +27,12 @@
 #ifndef text_h
 #define text_h
 
-void version(void);
-void usage(void);
-void license(void);
-void man_page_source(void);
+#include <stdio.h>
+
+void version(FILE *out);
+void usage(FILE *out);
+void license(FILE *out);
+void man_page_source(FILE *out);
 
 #endif /* text_h */
 
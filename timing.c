@@ -0,0 +1,140 @@
+//
+// timing.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// breakdown of where one invocation spends its time, printed by blinkt --timing and added to the
+// stats file when the profile has stats on. Also the clock, deadline sleep and stop signal that
+// every mode running its own frame loop shares.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "timing.h"
+
+bool timing_on = false;
+
+volatile sig_atomic_t stop_requested = false;
+
+static const char *phase_names[NUM_PHASES] = {
+    "state load",
+    "command",
+    "gpio init",
+    "frame output",
+    "state save",
+    "gpio close",
+};
+
+static int64_t startup_ns;              // CPU time used before main
+static int64_t start_ns;
+static int64_t mark_ns;
+static int64_t phase_ns[NUM_PHASES];
+
+static int64_t clock_ns(clockid_t clock)
+{
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void start_timing(void)
+{
+    int k;
+
+    // loading and linking the program happen before main, so only their CPU time can be seen
+    startup_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    start_ns = mark_ns = clock_ns(CLOCK_MONOTONIC);
+    for (k = 0; k < NUM_PHASES; k++) phase_ns[k] = 0;
+}
+
+void mark_phase(Phase phase)
+{
+    int64_t now;
+
+    if (!timing_on) return;
+
+    now = clock_ns(CLOCK_MONOTONIC);
+    phase_ns[phase] += now - mark_ns;
+    mark_ns = now;
+}
+
+void report_timing(FILE *out)
+{
+    int k;
+
+    fprintf(out, "%-14s %9.3f ms cpu\n", "startup", startup_ns / 1e6);
+    for (k = 0; k < NUM_PHASES; k++) {
+        fprintf(out, "%-14s %9.3f ms\n", phase_names[k], phase_ns[k] / 1e6);
+    }
+    fprintf(out, "%-14s %9.3f ms\n", "total in main", (clock_ns(CLOCK_MONOTONIC) - start_ns) / 1e6);
+}
+
+int64_t phase_time(Phase phase)
+{
+    return phase_ns[phase];
+}
+
+const char *phase_name(Phase phase)
+{
+    return phase_names[phase];
+}
+
+int64_t now_ns(void)
+{
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+static void handle_stop(int signal)
+{
+    stop_requested = true;
+}
+
+void catch_stop(void)
+{
+    struct sigaction action;
+
+    // no SA_RESTART, so a signal interrupts a read or wait that would otherwise block
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+bool sleep_until(int64_t deadline)
+{
+    struct timespec when;
+
+    when.tv_sec = deadline / 1000000000;
+    when.tv_nsec = deadline % 1000000000;
+
+    // interrupted by other signals: keep waiting
+    while (!stop_requested) {
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == 0) return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,73 @@
+//
+// timing.h
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef timing_h
+#define timing_h
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// parts of one blinkt invocation, in the order they happen
+typedef enum {
+    PHASE_STATE_LOAD,
+    PHASE_COMMAND,
+    PHASE_GPIO_INIT,
+    PHASE_FRAME,
+    PHASE_STATE_SAVE,
+    PHASE_GPIO_CLOSE,
+    NUM_PHASES
+} Phase;
+
+extern bool timing_on;
+
+// start timing; call first thing in main
+void start_timing(void);
+
+// charge time since previous mark to phase
+void mark_phase(Phase phase);
+
+void report_timing(FILE *out);
+
+// time charged to phase so far, in nanoseconds
+int64_t phase_time(Phase phase);
+
+const char *phase_name(Phase phase);
+
+// monotonic clock in nanoseconds
+int64_t now_ns(void);
+
+// set by SIGINT or SIGTERM once catch_stop() has been called
+extern volatile sig_atomic_t stop_requested;
+
+// have SIGINT and SIGTERM set stop_requested, so a mode can stop cleanly; a wait they interrupt
+// returns rather than restarting
+void catch_stop(void);
+
+// sleep until deadline on monotonic clock, or not at all if already past; false if stopped first
+bool sleep_until(int64_t deadline);
+
+#endif /* timing_h */
@@ -0,0 +1,127 @@
+//
+// update.c
+// blinkt
+//
+// Copyright (C) 2022 Michael Budiansky. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// Redistributions of source code must retain the above copyright notice, this list of conditions
+// and the following disclaimer.
+//
+// Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+// and the following disclaimer in the documentation and/or other materials provided with the
+// distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+// WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// one command as one update of the state file, shared by blinkt and its script modes. See state.c
+// for how the state and bus locks are used.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "blinkt.h"
+#include "command.h"
+#include "fade.h"
+#include "text.h"
+#include "timing.h"
+#include "update.h"
+
+// state generation when our fade started
+static uint32_t fade_generation;
+
+// true once another process has written state, so fade should give way to newer state
+static bool state_replaced(void)
+{
+    return state_generation() != fade_generation;
+}
+
+bool apply_command(int argc, const char *argv[])
+{
+    Pixel *previous_pixels = alloc_pixels();
+    Pixel *pixels = alloc_pixels();
+    Flags previous_flags;
+    Flags flags;
+    bool locked;
+    bool changed;
+
+    // initialize data structures
+    init_state(&flags, pixels);
+
+    // keep other blinkt processes from changing state until ours is written
+    locked = begin_state_update(FILE_PATH);
+
+    // read state file if present; OK if does not exist
+    read_state_file(FILE_PATH, &flags, pixels);
+    mark_phase(PHASE_STATE_LOAD);
+
+    copy_state(&flags, pixels, &previous_flags, previous_pixels);
+
+    // fade frames are sent after state is saved and unlocked
+    defer_fades = true;
+
+    if (argc > 1) {
+        run_command(argc, argv, &flags, pixels, stdout, stderr);
+
+    } else {
+        // if no options, print help
+        usage(stdout);
+    }
+    mark_phase(PHASE_COMMAND);
+
+    // GPIO is opened only if a frame has to be sent
+    changed = !states_are_same(&previous_flags, previous_pixels, &flags, pixels);
+    if (changed) {
+        write_state_file(FILE_PATH, flags, pixels);
+        end_state_update();
+        mark_phase(PHASE_STATE_SAVE);
+
+        if (!locked) {
+            if (!flags.holding) {
+                if (fade_running()) play_fade(flags, NULL);
+                write_to_blinkt(flags, pixels);
+            }
+            mark_phase(PHASE_FRAME);
+
+        } else {
+            // if another process is sending, skip fade and leave newest state to it
+            if (fade_running() && !flags.holding && try_lock_bus()) {
+                fade_generation = state_generation();
+                play_fade(flags, state_replaced);
+                unlock_bus();
+                mark_phase(PHASE_FRAME);
+            }
+
+            // if another process is sending, it will send our change too; otherwise send newest
+            // state until no more changes arrive
+            while (try_lock_bus()) {
+                uint32_t generation = state_generation();
+
+                read_state_file(FILE_PATH, &flags, pixels);
+                if (!flags.holding) write_to_blinkt(flags, pixels);
+                unlock_bus();
+                mark_phase(PHASE_FRAME);
+
+                if (state_generation() == generation) break;
+            }
+        }
+    }
+
+    end_state_update();
+    stop_fade();
+
+    free(pixels);
+    free(previous_pixels);
+
+    return changed;
+}